@@ -0,0 +1,672 @@
+/*
+  ==============================================================================
+
+    Differential accuracy harness: every engine against a double precision
+    reference cascade, across signals, sample rates and precisions.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+#include <complex>
+#include <iostream>
+#include <map>
+
+/**
+    The reference is the plain serial cascade the engines all have to match:
+    one transposed direct form II biquad per band, in double, with coefficients
+    straight from juce::dsp::IIR::ArrayCoefficients<double>::makePeakFilter, the
+    same design PeakCoefficientTable tabulates.
+    
+    Each case builds a fresh processor the way a host would and runs a signal
+    through processBlock() one block at a time, with the reference fed the very
+    same samples (rounded to float first for float cases, so the input's own
+    quantisation isn't counted). Reported per case:
+    
+        max error       largest absolute difference, dBFS
+        rms error       dBFS
+        null depth      rms error relative to the reference's rms, dB
+        stable          every output finite, and never more than twice the reference's peak
+    
+    The impulse, sweep and noise cases pass when they're stable and null at
+    least as deep as the threshold for their precision. The denormal case runs
+    noise at the bottom of float's normal range, where flushing to zero is the
+    expected result, and the automated case moves the gains along random
+    trajectories, one 0.5 dB step at a time at block boundaries (with smoothing
+    off, the reference switches coefficients at the same boundaries). The
+    cascade runs the same biquads on the same state, so it has to null there
+    too. Engines that keep different state than a biquad, like the parallel
+    form and the SVFs, legitimately differ from the reference for a moment
+    after every change, so those two only have to be stable.
+    
+    With --multithreading on, every case also runs with the worker pool, next to
+    a single threaded twin of the same processor. Whichever thread a task lands
+    on has to compute exactly what the audio thread would, flushing subnormals
+    included, so those cases must match their twin bit for bit on top of the
+    rest; the denormal case is the one that catches a worker that doesn't flush.
+    
+    The linear phase engine shares only the magnitude response, so it's judged
+    on that instead: its impulse response against the reference's |H| at log
+    spaced frequencies over the range its kernel resolves.
+    
+    The exit code is 1 if any case fails, so this can gate a change to an engine.
+*/
+namespace
+{
+    using FilterEngine = GraphicEQAudioProcessor::FilterEngine;
+    
+    constexpr int numChannels = 2;
+    constexpr int numMagnitudePoints = 512;
+    constexpr double minimumDecibels = -400.0;
+    
+    enum class Signal
+    {
+        impulse,
+        sweep,
+        noise,
+        denormal,
+        automated,
+        magnitude // linear phase only, replaces the others
+    };
+    
+    struct Case
+    {
+        FilterEngine engine = FilterEngine::cascade;
+        bool doublePrecision = false;
+        double sampleRate = 48000.0;
+        Signal signal = Signal::noise;
+        bool multithreaded = false;
+    };
+    
+    struct Result
+    {
+        double maxError = 0.0, rmsError = 0.0, nullDepth = 0.0;
+        
+        // Magnitude cases only, in dB
+        double maxDeviation = 0.0, rmsDeviation = 0.0;
+        
+        bool stable = true;
+        bool matchesSerial = true; // multithreaded cases only
+        bool passed = true;
+    };
+    
+    struct Settings
+    {
+        double seconds = 1.0;
+        int blockSize = 256;
+        int seed = 1;
+        double floatThreshold = -60.0;
+        double doubleThreshold = -120.0;
+        double magnitudeTolerance = 1.0;
+    };
+    
+    const std::map<juce::String, FilterEngine> engineNames { { "cascade", FilterEngine::cascade },
+                                                             { "parallel", FilterEngine::parallel },
+                                                             { "svf", FilterEngine::svf },
+                                                             { "linear-phase", FilterEngine::linearPhase } };
+    
+    const std::map<juce::String, Signal> signalNames { { "impulse", Signal::impulse },
+                                                       { "sweep", Signal::sweep },
+                                                       { "noise", Signal::noise },
+                                                       { "denormal", Signal::denormal },
+                                                       { "automated", Signal::automated } };
+    
+    template <typename Map, typename Value>
+    juce::String getName(const Map& names, Value value)
+    {
+        for (auto const& [name, v] : names)
+            if (v == value)
+                return name;
+        
+        return {};
+    }
+    
+    juce::String getKey(const Case& c)
+    {
+        return getName(engineNames, c.engine)
+             + (c.doublePrecision ? " double" : " float")
+             + " " + juce::String(c.sampleRate, 0)
+             + " " + (c.signal == Signal::magnitude ? juce::String("magnitude") : getName(signalNames, c.signal))
+             + (c.multithreaded ? " mt" : "");
+    }
+    
+    double toDecibels(double value)
+    {
+        return value > 0.0 ? juce::jmax(minimumDecibels, 20.0 * std::log10(value)) : minimumDecibels;
+    }
+    
+    // Every band away from 0 dB, cuts and boosts alternating, like the benchmarks' busy preset
+    float getBusyGain(int band)
+    {
+        return (band % 2 == 0 ? 1.0f : -1.0f) * (3.0f + 1.5f * (float) (band % 4));
+    }
+    
+    // Mostly single steps, now and then a jump, the way a hand on a control surface moves
+    void stepGains(std::array<float, numBands>& gains, juce::Random& random)
+    {
+        for (auto& gain : gains) {
+            auto const r = random.nextFloat();
+            
+            if (r < 0.02f)
+                gain = -12.0f + 0.5f * (float) random.nextInt(49);
+            else if (r < 0.27f)
+                gain = juce::jlimit(-12.0f, 12.0f, gain + (random.nextBool() ? 0.5f : -0.5f));
+        }
+    }
+    
+    // What plugin wrappers do with host automation
+    void setGain(juce::RangedAudioParameter& parameter, float gainInDecibels)
+    {
+        auto const value = parameter.convertTo0to1(gainInDecibels);
+        parameter.setValue(value);
+        parameter.sendValueChangedMessageToListeners(value);
+    }
+    
+    class ReferenceCascade
+    {
+    public:
+        explicit ReferenceCascade(double rate) : sampleRate(rate) {}
+        
+        void setGains(const std::array<float, numBands>& gains)
+        {
+            for (int band = 0; band < numBands; ++band) {
+                if (hasCoefficients && gains[(size_t) band] == currentGains[(size_t) band])
+                    continue;
+                
+                auto const c = juce::dsp::IIR::ArrayCoefficients<double>::makePeakFilter(sampleRate,
+                                                                                         Bands::freqs[(size_t) band],
+                                                                                         Bands::qualities[(size_t) band],
+                                                                                         juce::Decibels::decibelsToGain((double) gains[(size_t) band]));
+                auto const a0Inv = 1.0 / c[3];
+                coefficients[(size_t) band] = { c[0] * a0Inv, c[1] * a0Inv, c[2] * a0Inv, c[4] * a0Inv, c[5] * a0Inv };
+            }
+            
+            currentGains = gains;
+            hasCoefficients = true;
+        }
+        
+        double processSample(int channel, double x) noexcept
+        {
+            for (int band = 0; band < numBands; ++band) {
+                auto const& c = coefficients[(size_t) band];
+                auto& s = states[(size_t) channel][(size_t) band];
+                
+                auto const y = c[0] * x + s[0];
+                s[0] = c[1] * x - c[3] * y + s[1];
+                s[1] = c[2] * x - c[4] * y;
+                x = y;
+            }
+            
+            return x;
+        }
+        
+        double getMagnitude(double frequency) const
+        {
+            auto const z = std::polar(1.0, -juce::MathConstants<double>::twoPi * frequency / sampleRate);
+            std::complex<double> response(1.0);
+            
+            for (auto const& c : coefficients)
+                response *= (c[0] + z * (c[1] + z * c[2])) / (1.0 + z * (c[3] + z * c[4]));
+            
+            return std::abs(response);
+        }
+    
+    private:
+        double sampleRate;
+        std::array<float, numBands> currentGains {};
+        bool hasCoefficients = false;
+        
+        std::array<std::array<double, 5>, numBands> coefficients {}; // b0, b1, b2, a1, a2
+        std::array<std::array<std::array<double, 2>, numBands>, numChannels> states {};
+    };
+    
+    // Double precision input, later rounded to the case's precision
+    juce::AudioBuffer<double> generate(Signal signal, double sampleRate, int numSamples, juce::Random& random)
+    {
+        juce::AudioBuffer<double> input(numChannels, numSamples);
+        input.clear();
+        
+        switch (signal) {
+            case Signal::impulse:
+                for (int channel = 0; channel < numChannels; ++channel)
+                    input.setSample(channel, 0, 1.0);
+                break;
+            
+            case Signal::sweep: {
+                // Exponential, 20 Hz to just below Nyquist over the whole signal
+                auto const f0 = 20.0, f1 = 0.45 * sampleRate;
+                auto const duration = numSamples / sampleRate;
+                auto const k = std::log(f1 / f0);
+                
+                for (int i = 0; i < numSamples; ++i) {
+                    auto const t = i / sampleRate;
+                    auto const phase = juce::MathConstants<double>::twoPi * f0 * duration / k * (std::exp(t / duration * k) - 1.0);
+                    
+                    for (int channel = 0; channel < numChannels; ++channel)
+                        input.setSample(channel, i, 0.5 * std::sin(phase));
+                }
+                break;
+            }
+            
+            case Signal::noise:
+            case Signal::automated:
+            case Signal::denormal: {
+                // Just above float's smallest normal number, so the filters' state decays through the subnormals
+                auto const amplitude = signal == Signal::denormal ? 1.0e-37 : 0.25;
+                
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < numSamples; ++i)
+                        input.setSample(channel, i, amplitude * (2.0 * random.nextDouble() - 1.0));
+                break;
+            }
+            
+            case Signal::magnitude:
+                break;
+        }
+        
+        return input;
+    }
+    
+    struct Processor
+    {
+        GraphicEQAudioProcessor processor;
+        std::array<juce::RangedAudioParameter*, numBands> parameters;
+        
+        Processor(const Case& c, int blockSize, const std::array<float, numBands>& gains)
+        {
+            processor.setFilterEngine(c.engine);
+            processor.setSmoothingInterval(0);
+            processor.setMultithreadingEnabled(c.multithreaded);
+            processor.setPlayConfigDetails(numChannels, numChannels, c.sampleRate, blockSize);
+            processor.setProcessingPrecision(c.doublePrecision ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+            
+            for (int band = 0; band < numBands; ++band)
+                parameters[(size_t) band] = processor.apvts.getParameter(Bands::names[(size_t) band]);
+            
+            setGains(gains);
+            processor.prepareToPlay(c.sampleRate, blockSize);
+        }
+        
+        ~Processor()
+        {
+            processor.releaseResources();
+        }
+        
+        void setGains(const std::array<float, numBands>& gains)
+        {
+            for (int band = 0; band < numBands; ++band)
+                setGain(*parameters[(size_t) band], gains[(size_t) band]);
+        }
+    };
+    
+    template <typename SampleType>
+    Result runSignal(const Case& c, const Settings& settings)
+    {
+        juce::Random random(settings.seed);
+        
+        std::array<float, numBands> gains;
+        
+        for (int band = 0; band < numBands; ++band)
+            gains[(size_t) band] = getBusyGain(band);
+        
+        Processor wrapper(c, settings.blockSize, gains);
+        ReferenceCascade reference(c.sampleRate);
+        reference.setGains(gains);
+        
+        auto const numSamples = juce::jmax(1, juce::roundToInt(settings.seconds * c.sampleRate));
+        auto const input = generate(c.signal, c.sampleRate, numSamples, random);
+        
+        juce::AudioBuffer<SampleType> buffer(numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+        
+        // The same processor without the worker pool, which a multithreaded case has to match exactly
+        std::unique_ptr<Processor> serialTwin;
+        juce::AudioBuffer<SampleType> serialBuffer;
+        
+        if (c.multithreaded) {
+            auto serialCase = c;
+            serialCase.multithreaded = false;
+            serialTwin = std::make_unique<Processor>(serialCase, settings.blockSize, gains);
+            serialBuffer.setSize(numChannels, settings.blockSize);
+        }
+        
+        double sumSquaredError = 0.0, sumSquaredReference = 0.0, maxError = 0.0, referencePeak = 0.0, outputPeak = 0.0;
+        bool finite = true, matchesSerial = true;
+        
+        for (int start = 0; start < numSamples; start += settings.blockSize) {
+            auto const blockLength = juce::jmin(settings.blockSize, numSamples - start);
+            
+            if (c.signal == Signal::automated) {
+                stepGains(gains, random);
+                wrapper.setGains(gains);
+                reference.setGains(gains);
+                
+                if (serialTwin != nullptr)
+                    serialTwin->setGains(gains);
+            }
+            
+            juce::AudioBuffer<SampleType> block(buffer.getArrayOfWritePointers(), numChannels, 0, blockLength);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int i = 0; i < blockLength; ++i)
+                    block.setSample(channel, i, (SampleType) input.getSample(channel, start + i));
+            
+            wrapper.processor.processBlock(block, midi);
+            
+            if (serialTwin != nullptr) {
+                juce::AudioBuffer<SampleType> serialBlock(serialBuffer.getArrayOfWritePointers(), numChannels, 0, blockLength);
+                
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < blockLength; ++i)
+                        serialBlock.setSample(channel, i, (SampleType) input.getSample(channel, start + i));
+                
+                serialTwin->processor.processBlock(serialBlock, midi);
+                
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < blockLength; ++i)
+                        matchesSerial = matchesSerial && block.getSample(channel, i) == serialBlock.getSample(channel, i);
+            }
+            
+            for (int channel = 0; channel < numChannels; ++channel) {
+                for (int i = 0; i < blockLength; ++i) {
+                    auto const expected = reference.processSample(channel, (double) (SampleType) input.getSample(channel, start + i));
+                    auto const actual = (double) block.getSample(channel, i);
+                    
+                    if (! std::isfinite(actual)) {
+                        finite = false;
+                        continue;
+                    }
+                    
+                    auto const error = std::abs(actual - expected);
+                    maxError = juce::jmax(maxError, error);
+                    sumSquaredError += error * error;
+                    sumSquaredReference += expected * expected;
+                    referencePeak = juce::jmax(referencePeak, std::abs(expected));
+                    outputPeak = juce::jmax(outputPeak, std::abs(actual));
+                }
+            }
+        }
+        
+        auto const count = (double) numSamples * numChannels;
+        
+        Result result;
+        result.maxError = toDecibels(maxError);
+        result.rmsError = toDecibels(std::sqrt(sumSquaredError / count));
+        result.nullDepth = sumSquaredReference > 0.0 ? toDecibels(std::sqrt(sumSquaredError / sumSquaredReference)) : minimumDecibels;
+        result.stable = finite && outputPeak <= 2.0 * referencePeak + 1.0e-30;
+        result.matchesSerial = matchesSerial;
+        
+        auto const threshold = c.doublePrecision ? settings.doubleThreshold : settings.floatThreshold;
+        auto const nullRequired = c.signal == Signal::impulse || c.signal == Signal::sweep || c.signal == Signal::noise
+                               || (c.signal == Signal::automated && c.engine == FilterEngine::cascade);
+        result.passed = result.stable && result.matchesSerial && (! nullRequired || result.nullDepth <= threshold);
+        return result;
+    }
+    
+    template <typename SampleType>
+    Result runMagnitude(const Case& c, const Settings& settings)
+    {
+        std::array<float, numBands> gains;
+        
+        for (int band = 0; band < numBands; ++band)
+            gains[(size_t) band] = getBusyGain(band);
+        
+        Processor wrapper(c, settings.blockSize, gains);
+        ReferenceCascade reference(c.sampleRate);
+        reference.setGains(gains);
+        
+        // Latency plus the whole kernel, so the impulse response is complete
+        auto const kernelLength = wrapper.processor.getLinearPhaseKernelLength();
+        auto const numSamples = wrapper.processor.getLatencySamples() + kernelLength;
+        
+        juce::AudioBuffer<SampleType> buffer(numChannels, settings.blockSize);
+        std::vector<double> response;
+        juce::MidiBuffer midi;
+        bool finite = true;
+        
+        for (int start = 0; start < numSamples; start += settings.blockSize) {
+            auto const blockLength = juce::jmin(settings.blockSize, numSamples - start);
+            juce::AudioBuffer<SampleType> block(buffer.getArrayOfWritePointers(), numChannels, 0, blockLength);
+            block.clear();
+            
+            if (start == 0)
+                for (int channel = 0; channel < numChannels; ++channel)
+                    block.setSample(channel, 0, (SampleType) 1);
+            
+            wrapper.processor.processBlock(block, midi);
+            
+            for (int i = 0; i < blockLength; ++i) {
+                auto const sample = (double) block.getSample(0, i);
+                finite = finite && std::isfinite(sample);
+                response.push_back(sample);
+            }
+        }
+        
+        // Below a few kernel bins the bands can't be resolved, and that's a matter of kernel length, not accuracy
+        auto const lowest = juce::jmax(20.0, 8.0 * c.sampleRate / kernelLength);
+        auto const highest = juce::jmin(20000.0, 0.45 * c.sampleRate);
+        
+        double maxDeviation = 0.0, sumSquaredDeviation = 0.0;
+        
+        for (int point = 0; point < numMagnitudePoints; ++point) {
+            auto const frequency = lowest * std::pow(highest / lowest, (double) point / (numMagnitudePoints - 1));
+            auto const rotation = std::polar(1.0, -juce::MathConstants<double>::twoPi * frequency / c.sampleRate);
+            
+            std::complex<double> z(1.0), sum;
+            
+            for (auto const sample : response) {
+                sum += sample * z;
+                z *= rotation;
+            }
+            
+            auto const deviation = std::abs(toDecibels(std::abs(sum)) - toDecibels(reference.getMagnitude(frequency)));
+            maxDeviation = juce::jmax(maxDeviation, deviation);
+            sumSquaredDeviation += deviation * deviation;
+        }
+        
+        Result result;
+        result.maxDeviation = maxDeviation;
+        result.rmsDeviation = std::sqrt(sumSquaredDeviation / numMagnitudePoints);
+        result.stable = finite;
+        result.passed = finite && maxDeviation <= settings.magnitudeTolerance;
+        return result;
+    }
+    
+    juce::String describe(const Case& c, const Result& r)
+    {
+        auto line = getKey(c).paddedRight(' ', 40);
+        
+        if (c.signal == Signal::magnitude) {
+            line << juce::String(r.maxDeviation, 3).paddedLeft(' ', 9) << " dB max deviation"
+                 << juce::String(r.rmsDeviation, 3).paddedLeft(' ', 9) << " dB rms deviation";
+        } else {
+            line << juce::String(r.maxError, 1).paddedLeft(' ', 8) << " dBFS max"
+                 << juce::String(r.rmsError, 1).paddedLeft(' ', 8) << " dBFS rms"
+                 << juce::String(r.nullDepth, 1).paddedLeft(' ', 8) << " dB null";
+        }
+        
+        line << (r.stable ? "  stable" : "  UNSTABLE");
+        
+        if (c.multithreaded)
+            line << (r.matchesSerial ? "  = serial" : "  != SERIAL");
+        
+        line << (r.passed ? "  ok" : "  FAIL");
+        return line;
+    }
+    
+    juce::var toVar(const Case& c, const Result& r)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("key", getKey(c));
+        object->setProperty("engine", getName(engineNames, c.engine));
+        object->setProperty("precision", c.doublePrecision ? "double" : "float");
+        object->setProperty("sampleRate", c.sampleRate);
+        object->setProperty("signal", c.signal == Signal::magnitude ? juce::String("magnitude") : getName(signalNames, c.signal));
+        object->setProperty("multithreaded", c.multithreaded);
+        
+        if (c.signal == Signal::magnitude) {
+            object->setProperty("maxDeviationDb", r.maxDeviation);
+            object->setProperty("rmsDeviationDb", r.rmsDeviation);
+        } else {
+            object->setProperty("maxErrorDbfs", r.maxError);
+            object->setProperty("rmsErrorDbfs", r.rmsError);
+            object->setProperty("nullDepthDb", r.nullDepth);
+        }
+        
+        object->setProperty("stable", r.stable);
+        
+        if (c.multithreaded)
+            object->setProperty("matchesSerial", r.matchesSerial);
+        
+        object->setProperty("passed", r.passed);
+        return juce::var(object);
+    }
+    
+    // A comma separated option, or the defaults if it isn't given
+    juce::StringArray getList(const juce::ArgumentList& arguments, const juce::String& option, const juce::String& defaults)
+    {
+        auto const text = arguments.containsOption(option) ? arguments.getValueForOption(option) : defaults;
+        return juce::StringArray::fromTokens(text, ",", {});
+    }
+    
+    void printUsage()
+    {
+        std::cout << "Usage: GraphicEQAccuracy [options]\n"
+                     "\n"
+                     "Lists are comma separated, the defaults are shown.\n"
+                     "  --engines=cascade,parallel,svf,linear-phase\n"
+                     "  --precision=float,double\n"
+                     "  --sample-rates=44100,48000,96000,192000,384000\n"
+                     "  --signals=impulse,sweep,noise,denormal,automated   (linear-phase always runs magnitude)\n"
+                     "  --multithreading=off,on              on also has to match a single threaded run exactly\n"
+                     "  --seconds=1                          length of each signal\n"
+                     "  --block-size=256\n"
+                     "  --seed=1                             noise and automation\n"
+                     "  --float-threshold=-60                null depth float cases must reach, dB\n"
+                     "  --double-threshold=-120              null depth double cases must reach, dB\n"
+                     "  --magnitude-tolerance=1              linear phase magnitude deviation allowed, dB\n"
+                     "  --output=<file.json>                 machine-readable results\n"
+                     "\n"
+                     "Exits with 1 if any case fails.\n";
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList arguments(argc, argv);
+    
+    if (arguments.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+    
+    Settings settings;
+    
+    if (arguments.containsOption("--seconds"))
+        settings.seconds = juce::jmax(0.01, arguments.getValueForOption("--seconds").getDoubleValue());
+    
+    if (arguments.containsOption("--block-size"))
+        settings.blockSize = juce::jmax(1, arguments.getValueForOption("--block-size").getIntValue());
+    
+    if (arguments.containsOption("--seed"))
+        settings.seed = arguments.getValueForOption("--seed").getIntValue();
+    
+    if (arguments.containsOption("--float-threshold"))
+        settings.floatThreshold = arguments.getValueForOption("--float-threshold").getDoubleValue();
+    
+    if (arguments.containsOption("--double-threshold"))
+        settings.doubleThreshold = arguments.getValueForOption("--double-threshold").getDoubleValue();
+    
+    if (arguments.containsOption("--magnitude-tolerance"))
+        settings.magnitudeTolerance = arguments.getValueForOption("--magnitude-tolerance").getDoubleValue();
+    
+    auto const engines = getList(arguments, "--engines", "cascade,parallel,svf,linear-phase");
+    auto const signals = getList(arguments, "--signals", "impulse,sweep,noise,denormal,automated");
+    
+    for (auto const& engineName : engines) {
+        if (engineNames.count(engineName) == 0) {
+            std::cerr << "Unknown engine: " << engineName << "\n";
+            return 1;
+        }
+    }
+    
+    for (auto const& signalName : signals) {
+        if (signalNames.count(signalName) == 0) {
+            std::cerr << "Unknown signal: " << signalName << "\n";
+            return 1;
+        }
+    }
+    
+    std::vector<Case> cases;
+    
+    for (auto const& engineName : engines) {
+        for (auto const& precision : getList(arguments, "--precision", "float,double")) {
+            for (auto const& sampleRate : getList(arguments, "--sample-rates", "44100,48000,96000,192000,384000")) {
+                Case c;
+                c.engine = engineNames.at(engineName);
+                c.doublePrecision = precision == "double";
+                c.sampleRate = sampleRate.getDoubleValue();
+                
+                // The convolvers don't use the worker pool
+                if (c.engine == FilterEngine::linearPhase) {
+                    c.signal = Signal::magnitude;
+                    cases.push_back(c);
+                    continue;
+                }
+                
+                for (auto const& signalName : signals) {
+                    for (auto const& multithreading : getList(arguments, "--multithreading", "off,on")) {
+                        c.signal = signalNames.at(signalName);
+                        c.multithreaded = multithreading == "on";
+                        cases.push_back(c);
+                    }
+                }
+            }
+        }
+    }
+    
+    std::cout << numBands << " bands against a double precision reference cascade, block size " << settings.blockSize << "\n\n";
+    
+    juce::Array<juce::var> results;
+    int numFailed = 0;
+    
+    for (auto const& c : cases) {
+        Result result;
+        
+        if (c.signal == Signal::magnitude)
+            result = c.doublePrecision ? runMagnitude<double>(c, settings) : runMagnitude<float>(c, settings);
+        else
+            result = c.doublePrecision ? runSignal<double>(c, settings) : runSignal<float>(c, settings);
+        
+        results.add(toVar(c, result));
+        
+        if (! result.passed)
+            ++numFailed;
+        
+        std::cout << describe(c, result) << std::endl;
+    }
+    
+    std::cout << "\n" << (int) cases.size() - numFailed << " of " << (int) cases.size() << " cases passed\n";
+    
+    if (arguments.containsOption("--output")) {
+        auto* root = new juce::DynamicObject();
+        root->setProperty("bands", numBands);
+        root->setProperty("blockSize", settings.blockSize);
+        root->setProperty("seconds", settings.seconds);
+        root->setProperty("seed", settings.seed);
+        root->setProperty("results", results);
+        
+        auto const output = arguments.getFileForOption("--output");
+        
+        if (! output.replaceWithText(juce::JSON::toString(juce::var(root)))) {
+            std::cerr << "Can't write " << output.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+    
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,452 @@
+/*
+  ==============================================================================
+
+    Headless batch renderer: runs WAV and FLAC files through the plugin's
+    processor with a saved preset, many files and chunks at a time.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+#include <iostream>
+#include <map>
+#include <mutex>
+
+/**
+    Every file is split into chunks of about --chunk-seconds, and every chunk is
+    one job on a thread pool with its own processor, so long files spread over
+    all cores just like many short ones do.
+    
+    A chunk can't start from silence, the filters would be missing whatever was
+    ringing through them at that point. So each one starts early and renders a
+    warm-up first, long enough for any difference in filter state to decay far
+    below the last bit of a float (twice the processor's tail, which already
+    goes down to -120 dB), and throws that part away. Chunks and warm-ups start
+    on multiples of the block size, which keeps the block grid, and with it
+    silence detection and smoothing, the same as in a single serial pass.
+    
+    Being sure beats being fast: the end of each chunk's warm-up is compared
+    bit for bit with the end of the chunk before it, and a file with any
+    mismatch is rendered again in one piece.
+*/
+namespace
+{
+    constexpr int blockSize = 4096;
+    constexpr int overlapCheckLength = 4096;
+    
+    struct Options
+    {
+        juce::MemoryBlock preset;
+        juce::File outputDirectory;
+        juce::String format;
+        int bitDepth = 0;
+        double chunkSeconds = 30.0;
+    };
+    
+    // An empty preset leaves every band at its default
+    std::unique_ptr<GraphicEQAudioProcessor> createProcessor(const juce::MemoryBlock& preset, int numChannels, double sampleRate)
+    {
+        auto processor = std::make_unique<GraphicEQAudioProcessor>();
+        
+        if (preset.getSize() > 0)
+            processor->setStateInformation(preset.getData(), (int) preset.getSize());
+        
+        // The pool already keeps every core busy, a worker pool per instance would only get in the way
+        processor->setMultithreadingEnabled(false);
+        
+        processor->setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+        processor->setNonRealtime(true);
+        processor->prepareToPlay(sampleRate, blockSize);
+        
+        return processor;
+    }
+    
+    // Copies whatever part of a rendered block falls inside destination, which starts at destinationStart in the file
+    void copyOverlap(const juce::AudioBuffer<float>& block, juce::int64 blockStart,
+                     juce::AudioBuffer<float>& destination, juce::int64 destinationStart)
+    {
+        auto const begin = juce::jmax(blockStart, destinationStart);
+        auto const end = juce::jmin(blockStart + block.getNumSamples(), destinationStart + destination.getNumSamples());
+        
+        if (begin >= end)
+            return;
+        
+        for (int channel = 0; channel < destination.getNumChannels(); ++channel)
+            destination.copyFrom(channel, (int) (begin - destinationStart), block, channel, (int) (begin - blockStart), (int) (end - begin));
+    }
+    
+    // Runs [from, to) of the file through the processor, in whole blocks so that every render sees the same
+    // block grid. Each output block goes to consume() with the file position it lines up with, latency taken out.
+    template <typename Consumer>
+    void render(GraphicEQAudioProcessor& processor, juce::AudioFormatReader& reader, juce::int64 from, juce::int64 to, Consumer&& consume)
+    {
+        jassert(from % blockSize == 0);
+        
+        auto const latency = processor.getLatencySamples();
+        juce::AudioBuffer<float> buffer((int) reader.numChannels, blockSize);
+        juce::MidiBuffer midi;
+        
+        for (auto position = from; position < to + latency; position += blockSize) {
+            // Reading past the end gives silence, which is what flushes the latency out
+            reader.read(&buffer, 0, blockSize, position, true, true);
+            processor.processBlock(buffer, midi);
+            consume(buffer, position - latency);
+        }
+    }
+    
+    struct Chunk
+    {
+        juce::AudioBuffer<float> output;
+        juce::AudioBuffer<float> warmUpEnd; // the last samples of the warm-up, for checking against the previous chunk
+    };
+    
+    class FileJob
+    {
+    public:
+        FileJob(const juce::File& inputFile, const juce::File& outputFile, const Options& options, juce::AudioFormatManager& formats)
+            : input(inputFile), output(outputFile), preset(options.preset), formatManager(formats)
+        {
+            auto reader = createReader();
+            
+            if (reader == nullptr) {
+                error = "can't be read";
+                return;
+            }
+            
+            sampleRate = reader->sampleRate;
+            numChannels = (int) reader->numChannels;
+            length = reader->lengthInSamples;
+            
+            outputFormat = formatManager.findFormatForFileExtension(output.getFileExtension());
+            
+            if (outputFormat == nullptr) {
+                error = "no format for " + output.getFileExtension();
+                return;
+            }
+            
+            // The input's depth if the output format has it, the deepest one it has otherwise
+            auto const depths = outputFormat->getPossibleBitDepths();
+            bitDepth = options.bitDepth > 0 ? options.bitDepth : (int) reader->bitsPerSample;
+            
+            if (! depths.contains(bitDepth))
+                bitDepth = depths.getLast();
+            
+            // Same preset, same sample rate: the tail is what every chunk's processor will report too
+            auto const processor = createProcessor(preset, numChannels, sampleRate);
+            auto const tail = (juce::int64) std::ceil(processor->getTailLengthSeconds() * sampleRate);
+            
+            // Also at least one block longer than the tail, so that silence detection agrees on whether it's idle
+            warmUpLength = roundUpToBlock(2 * tail + blockSize);
+            
+            auto const chunkLength = roundUpToBlock((juce::int64) (options.chunkSeconds * sampleRate));
+            
+            for (juce::int64 start = 0; start < length; start += chunkLength)
+                chunkStarts.push_back(start);
+            
+            chunkStarts.push_back(length);
+        }
+        
+        bool isValid() const { return error.isEmpty(); }
+        int getNumChunks() const { return (int) chunkStarts.size() - 1; }
+        double getLengthInSeconds() const { return (double) length / sampleRate; }
+        
+        void renderChunk(int index)
+        {
+            auto reader = createReader();
+            auto processor = createProcessor(preset, numChannels, sampleRate);
+            
+            auto const start = chunkStarts[(size_t) index];
+            auto const end = chunkStarts[(size_t) index + 1];
+            auto const warmUpStart = juce::jmax((juce::int64) 0, start - warmUpLength);
+            
+            Chunk chunk;
+            chunk.output.setSize(numChannels, (int) (end - start));
+            chunk.warmUpEnd.setSize(numChannels, (int) juce::jmin((juce::int64) overlapCheckLength, start - warmUpStart));
+            
+            auto const warmUpEndStart = start - chunk.warmUpEnd.getNumSamples();
+            
+            render(*processor, *reader, warmUpStart, end, [&](const juce::AudioBuffer<float>& block, juce::int64 position)
+            {
+                copyOverlap(block, position, chunk.warmUpEnd, warmUpEndStart);
+                copyOverlap(block, position, chunk.output, start);
+            });
+            
+            addChunk(index, std::move(chunk));
+        }
+        
+        // The fallback, and the reference the chunks have to match
+        void renderSerially()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            
+            auto reader = createReader();
+            auto processor = createProcessor(preset, numChannels, sampleRate);
+            
+            if (! createWriter())
+                return;
+            
+            render(*processor, *reader, 0, length, [&](const juce::AudioBuffer<float>& block, juce::int64 position)
+            {
+                // The first blocks are all latency when that's longer than a block, the last one runs past the end
+                auto const begin = juce::jmax((juce::int64) 0, position);
+                auto const end = juce::jmin(position + block.getNumSamples(), length);
+                
+                if (begin < end)
+                    write(block, (int) (begin - position), (int) (end - begin));
+            });
+            
+            writer.reset();
+            renderedSerially = true;
+        }
+        
+        bool needsSerialRender() const { return chunksDiverged; }
+        
+        juce::String getStatus() const
+        {
+            if (! isValid())
+                return "failed, " + error;
+            
+            auto status = juce::String(getNumChunks()) + (getNumChunks() == 1 ? " chunk" : " chunks");
+            
+            if (renderedSerially && getNumChunks() > 1)
+                status += ", chunks diverged, rendered serially";
+            
+            return status;
+        }
+        
+        const juce::File input, output;
+    
+    private:
+        static juce::int64 roundUpToBlock(juce::int64 numSamples)
+        {
+            return juce::jmax((juce::int64) blockSize, (numSamples + blockSize - 1) / blockSize * blockSize);
+        }
+        
+        std::unique_ptr<juce::AudioFormatReader> createReader() const
+        {
+            // Readers aren't thread safe, every job opens its own
+            return std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(input));
+        }
+        
+        bool createWriter()
+        {
+            output.deleteFile();
+            auto stream = output.createOutputStream();
+            
+            if (stream != nullptr)
+                writer.reset(outputFormat->createWriterFor(stream.get(), sampleRate, (unsigned int) numChannels, bitDepth, {}, 0));
+            
+            if (writer == nullptr) {
+                error = "can't write " + output.getFullPathName();
+                return false;
+            }
+            
+            // The writer owns the stream now
+            stream.release();
+            return true;
+        }
+        
+        void write(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+        {
+            if (writer != nullptr && ! writer->writeFromAudioSampleBuffer(buffer, startSample, numSamples))
+                error = "can't write " + output.getFullPathName();
+        }
+        
+        // Chunks finish in any order, they're written in order
+        void addChunk(int index, Chunk chunk)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishedChunks.emplace(index, std::move(chunk));
+            
+            for (auto it = finishedChunks.find(nextChunk); it != finishedChunks.end(); it = finishedChunks.find(nextChunk)) {
+                auto const& next = it->second;
+                
+                if (nextChunk == 0)
+                    chunksDiverged = ! createWriter();
+                else if (! chunksDiverged)
+                    chunksDiverged = ! matchesPreviousChunk(next.warmUpEnd);
+                
+                if (! chunksDiverged) {
+                    write(next.output, 0, next.output.getNumSamples());
+                    keepEnd(next.output);
+                }
+                
+                finishedChunks.erase(it);
+                ++nextChunk;
+            }
+            
+            if (nextChunk == getNumChunks() || chunksDiverged)
+                writer.reset();
+        }
+        
+        void keepEnd(const juce::AudioBuffer<float>& chunkOutput)
+        {
+            auto const numSamples = juce::jmin(overlapCheckLength, chunkOutput.getNumSamples());
+            previousChunkEnd.setSize(numChannels, numSamples, false, false, true);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                previousChunkEnd.copyFrom(channel, 0, chunkOutput, channel, chunkOutput.getNumSamples() - numSamples, numSamples);
+        }
+        
+        bool matchesPreviousChunk(const juce::AudioBuffer<float>& warmUpEnd) const
+        {
+            // Both end where the new chunk starts
+            auto const numSamples = juce::jmin(warmUpEnd.getNumSamples(), previousChunkEnd.getNumSamples());
+            
+            for (int channel = 0; channel < numChannels; ++channel) {
+                auto const* a = warmUpEnd.getReadPointer(channel, warmUpEnd.getNumSamples() - numSamples);
+                auto const* b = previousChunkEnd.getReadPointer(channel, previousChunkEnd.getNumSamples() - numSamples);
+                
+                if (std::memcmp(a, b, sizeof(float) * (size_t) numSamples) != 0)
+                    return false;
+            }
+            
+            return true;
+        }
+        
+        const juce::MemoryBlock& preset;
+        juce::AudioFormatManager& formatManager;
+        juce::AudioFormat* outputFormat = nullptr;
+        
+        double sampleRate = 0.0;
+        int numChannels = 0, bitDepth = 0;
+        juce::int64 length = 0, warmUpLength = 0;
+        std::vector<juce::int64> chunkStarts; // one more than there are chunks, the last one is the file's length
+        
+        std::mutex mutex;
+        std::map<int, Chunk> finishedChunks;
+        int nextChunk = 0;
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        juce::AudioBuffer<float> previousChunkEnd;
+        bool chunksDiverged = false, renderedSerially = false;
+        juce::String error;
+    };
+    
+    bool loadPreset(const juce::File& file, juce::MemoryBlock& preset)
+    {
+        // Either what getStateInformation() wrote, or the same state as XML
+        if (file.hasFileExtension("xml")) {
+            auto const state = juce::ValueTree::fromXml(file.loadFileAsString());
+            
+            if (! state.isValid())
+                return false;
+            
+            juce::MemoryOutputStream stream(preset, false);
+            state.writeToStream(stream);
+            return true;
+        }
+        
+        return file.loadFileAsData(preset);
+    }
+    
+    void waitForJobs(juce::ThreadPool& pool)
+    {
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(10);
+    }
+    
+    void printUsage()
+    {
+        std::cout << "Usage: GraphicEQBatchRenderer --output-dir=<dir> [options] <file>...\n"
+                     "\n"
+                     "  --preset=<file>        state saved by the plugin, binary or XML (default: flat)\n"
+                     "  --output-dir=<dir>     where rendered files go, with the same names\n"
+                     "  --format=<wav|flac>    output format (default: the input's)\n"
+                     "  --bits=<n>             output bit depth (default: the input's)\n"
+                     "  --threads=<n>          worker threads (default: one per core)\n"
+                     "  --chunk-seconds=<s>    length of the pieces long files are split into (default: 30)\n";
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList arguments(argc, argv);
+    
+    if (arguments.containsOption("--help|-h") || ! arguments.containsOption("--output-dir")) {
+        printUsage();
+        return 1;
+    }
+    
+    Options options;
+    options.outputDirectory = arguments.getFileForOption("--output-dir");
+    options.format = arguments.getValueForOption("--format").trimCharactersAtStart(".").toLowerCase();
+    options.bitDepth = arguments.getValueForOption("--bits").getIntValue();
+    
+    if (arguments.containsOption("--chunk-seconds"))
+        options.chunkSeconds = juce::jmax(1.0, arguments.getValueForOption("--chunk-seconds").getDoubleValue());
+    
+    auto const numThreads = arguments.containsOption("--threads") ? juce::jmax(1, arguments.getValueForOption("--threads").getIntValue())
+                                                                  : juce::SystemStats::getNumCpus();
+    
+    if (arguments.containsOption("--preset") && ! loadPreset(arguments.getExistingFileForOption("--preset"), options.preset)) {
+        std::cerr << "Can't read the preset\n";
+        return 1;
+    }
+    
+    if (! options.outputDirectory.createDirectory()) {
+        std::cerr << "Can't create " << options.outputDirectory.getFullPathName() << "\n";
+        return 1;
+    }
+    
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    
+    std::vector<std::unique_ptr<FileJob>> jobs;
+    
+    for (auto const& argument : arguments.arguments) {
+        if (argument.isOption())
+            continue;
+        
+        auto const input = argument.resolveAsFile();
+        auto output = options.outputDirectory.getChildFile(input.getFileName());
+        
+        if (options.format.isNotEmpty())
+            output = output.withFileExtension(options.format);
+        
+        if (output == input) {
+            std::cerr << input.getFullPathName() << ": would overwrite itself, skipped\n";
+            continue;
+        }
+        
+        jobs.push_back(std::make_unique<FileJob>(input, output, options, formatManager));
+    }
+    
+    juce::ThreadPool pool(numThreads);
+    auto const startTime = juce::Time::getMillisecondCounterHiRes();
+    
+    // One file's chunks are queued together, so they finish close together and don't wait long to be written
+    for (auto& job : jobs)
+        if (job->isValid())
+            for (int chunk = 0; chunk < job->getNumChunks(); ++chunk)
+                pool.addJob([&job = *job, chunk] { job.renderChunk(chunk); });
+    
+    waitForJobs(pool);
+    
+    for (auto& job : jobs)
+        if (job->isValid() && job->needsSerialRender())
+            pool.addJob([&job = *job] { job.renderSerially(); });
+    
+    waitForJobs(pool);
+    
+    auto const seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    double audioSeconds = 0.0;
+    int numFailed = 0;
+    
+    for (auto const& job : jobs) {
+        std::cout << job->input.getFileName() << ": " << job->getStatus() << "\n";
+        
+        if (job->isValid())
+            audioSeconds += job->getLengthInSeconds();
+        else
+            ++numFailed;
+    }
+    
+    std::cout << juce::String(audioSeconds, 1) << " s of audio in " << juce::String(seconds, 2) << " s on " << numThreads << " threads: "
+              << juce::String(audioSeconds / juce::jmax(seconds, 1.0e-6), 1) << "x realtime\n";
+    
+    return numFailed == 0 ? 0 : 1;
+}
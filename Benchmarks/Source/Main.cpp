@@ -0,0 +1,541 @@
+/*
+  ==============================================================================
+
+    processBlock() micro-benchmarks: time, cycles and allocations per sample
+    across block sizes, sample rates, channel counts, presets and automation.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/AllocationGuard.h"
+
+#include <iostream>
+#include <map>
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+/**
+    Each case builds a fresh processor the way a host would (play config,
+    precision, prepareToPlay()) and feeds it white noise, so that silence
+    detection never kicks in, one block at a time through processBlock().
+    
+    The noise lives in a region of a few blocks that's reset between passes
+    but otherwise stays in cache, like a host's buffers do. Only the blocks
+    themselves are timed, plus the parameter changes of automated cases,
+    which are made the way plugin wrappers make them, and for convert cases
+    the conversions to float and back. Everything is reported per sample per
+    channel, so channel counts can be compared directly.
+    
+    Cycles of multithreaded cases include what the worker threads spend. That
+    needs a PMU counter opened before the processor starts them, which every
+    case gets; where there's none, those cases report cycles as n/a rather
+    than the calling thread's share.
+    
+    The numbers are the median over --repeats runs of --seconds of audio each.
+    Results can be written as JSON with --output, and a previous run's JSON
+    given to --compare prints how every case moved since.
+*/
+namespace
+{
+    using FilterEngine = GraphicEQAudioProcessor::FilterEngine;
+    
+    constexpr int regionLength = 16384;
+    
+    // Core cycles from the PMU where Linux lets us read them, otherwise the x86 time stamp counter
+    // (constant rate, so only roughly cycles once the clock scales), otherwise nothing. The PMU counts
+    // this thread, plus, with includeNewThreads, every thread it starts from here on.
+    class CycleCounter
+    {
+    public:
+        explicit CycleCounter(bool includeNewThreads = false)
+        {
+           #if JUCE_LINUX
+            perf_event_attr attributes {};
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.inherit = includeNewThreads ? 1 : 0;
+            
+            descriptor = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+           #else
+            juce::ignoreUnused(includeNewThreads);
+           #endif
+        }
+        
+        ~CycleCounter()
+        {
+           #if JUCE_LINUX
+            if (descriptor >= 0)
+                close(descriptor);
+           #endif
+        }
+        
+        juce::String getSource() const
+        {
+            if (descriptor >= 0)
+                return "cpu-cycles";
+           
+           #if JUCE_INTEL
+            return "tsc";
+           #else
+            return "none";
+           #endif
+        }
+        
+        // Only the PMU can tell threads apart, the time stamp counter is the calling thread's view
+        bool countsThreads() const noexcept { return descriptor >= 0; }
+        
+        juce::uint64 read() const
+        {
+           #if JUCE_LINUX
+            juce::uint64 value = 0;
+            
+            if (descriptor >= 0 && ::read(descriptor, &value, sizeof(value)) == (ssize_t) sizeof(value))
+                return value;
+           #endif
+           
+           #if JUCE_INTEL
+            return (juce::uint64) __rdtsc();
+           #else
+            return 0;
+           #endif
+        }
+    
+    private:
+        int descriptor = -1;
+        
+        JUCE_DECLARE_NON_COPYABLE (CycleCounter)
+    };
+    
+    // Convert is a host with double buffers and a plugin that only processes float: each block is
+    // converted to float and back around processBlock(), as plugin wrappers do
+    enum class Precision
+    {
+        float32,
+        float64,
+        convert
+    };
+    
+    const std::map<juce::String, Precision> precisionNames { { "float", Precision::float32 },
+                                                             { "double", Precision::float64 },
+                                                             { "convert", Precision::convert } };
+    
+    struct Case
+    {
+        FilterEngine engine = FilterEngine::cascade;
+        Precision precision = Precision::float32;
+        int smoothingInterval = 0;
+        bool multithreaded = false;
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        int numChannels = 2;
+        bool busy = false;
+        bool automated = false;
+    };
+    
+    struct Result
+    {
+        double nsPerSample = 0.0, minNsPerSample = 0.0;
+        double cyclesPerSample = 0.0;
+        bool cyclesCounted = true; // false where the workers' cycles couldn't be counted
+        juce::uint64 allocations = 0;
+        double allocationsPerBlock = 0.0;
+        double realtimeFactor = 0.0;
+    };
+    
+    struct Settings
+    {
+        double seconds = 1.0;
+        int repeats = 5;
+    };
+    
+    const std::map<juce::String, FilterEngine> engineNames { { "cascade", FilterEngine::cascade },
+                                                             { "parallel", FilterEngine::parallel },
+                                                             { "svf", FilterEngine::svf },
+                                                             { "linear-phase", FilterEngine::linearPhase } };
+    
+    juce::String getEngineName(FilterEngine engine)
+    {
+        for (auto const& [name, value] : engineNames)
+            if (value == engine)
+                return name;
+        
+        return {};
+    }
+    
+    juce::String getPrecisionName(Precision precision)
+    {
+        for (auto const& [name, value] : precisionNames)
+            if (value == precision)
+                return name;
+        
+        return {};
+    }
+    
+    // Identifies a case across runs, --compare matches on it
+    juce::String getKey(const Case& c)
+    {
+        return getEngineName(c.engine)
+             + " " + getPrecisionName(c.precision)
+             + " smoothing " + juce::String(c.smoothingInterval)
+             + (c.multithreaded ? " mt" : " st")
+             + " " + juce::String(c.sampleRate, 0)
+             + " " + juce::String(c.blockSize)
+             + " x" + juce::String(c.numChannels)
+             + (c.busy ? " busy" : " flat")
+             + (c.automated ? " automated" : " static");
+    }
+    
+    // Every band away from 0 dB, cuts and boosts alternating
+    float getBusyGain(int band)
+    {
+        return (band % 2 == 0 ? 1.0f : -1.0f) * (3.0f + 1.5f * (float) (band % 4));
+    }
+    
+    // Every band moves by at least one 0.5 dB step on every block
+    float getAutomatedGain(int band, int blockIndex)
+    {
+        return -12.0f + 0.5f * (float) ((blockIndex + 5 * band) % 49);
+    }
+    
+    // What plugin wrappers do with host automation
+    void setGain(juce::RangedAudioParameter& parameter, float gainInDecibels)
+    {
+        auto const value = parameter.convertTo0to1(gainInDecibels);
+        parameter.setValue(value);
+        parameter.sendValueChangedMessageToListeners(value);
+    }
+    
+    template <typename SampleType>
+    Result run(const Case& c, const Settings& settings)
+    {
+        GraphicEQAudioProcessor processor;
+        processor.setFilterEngine(c.engine);
+        processor.setSmoothingInterval(c.smoothingInterval);
+        processor.setMultithreadingEnabled(c.multithreaded);
+        processor.setPlayConfigDetails(c.numChannels, c.numChannels, c.sampleRate, c.blockSize);
+        processor.setProcessingPrecision(c.precision == Precision::float64 ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+        
+        std::array<juce::RangedAudioParameter*, numBands> parameters;
+        
+        for (int band = 0; band < numBands; ++band) {
+            parameters[(size_t) band] = processor.apvts.getParameter(Bands::names[(size_t) band]);
+            setGain(*parameters[(size_t) band], c.busy ? getBusyGain(band) : 0.0f);
+        }
+        
+        // Opened before prepareToPlay() starts the worker pool, so that it can follow the workers too
+        CycleCounter const cycleCounter(c.multithreaded);
+        
+        processor.prepareToPlay(c.sampleRate, c.blockSize);
+        
+        // A whole number of blocks, so that every block in the region is full
+        auto const blocksPerPass = juce::jmax(1, regionLength / c.blockSize);
+        auto const samplesPerPass = blocksPerPass * c.blockSize;
+        auto const passesPerRepeat = juce::jmax(1, juce::roundToInt(settings.seconds * c.sampleRate / samplesPerPass));
+        
+        juce::AudioBuffer<SampleType> noise(c.numChannels, samplesPerPass);
+        juce::AudioBuffer<SampleType> region(c.numChannels, samplesPerPass);
+        juce::Random random(0x6e71);
+        
+        for (int channel = 0; channel < c.numChannels; ++channel)
+            for (int i = 0; i < samplesPerPass; ++i)
+                noise.setSample(channel, i, (SampleType) (0.25 * (2.0 * random.nextDouble() - 1.0)));
+        
+        // Views into the region, made up front so that the timed loop doesn't allocate anything itself
+        std::vector<std::unique_ptr<juce::AudioBuffer<SampleType>>> blocks;
+        
+        for (int block = 0; block < blocksPerPass; ++block)
+            blocks.push_back(std::make_unique<juce::AudioBuffer<SampleType>>(region.getArrayOfWritePointers(), c.numChannels, block * c.blockSize, c.blockSize));
+        
+        juce::MidiBuffer midi;
+        int blockIndex = 0;
+        
+        // Only used by convert cases, where the region holds the host's double buffers
+        juce::AudioBuffer<float> converted(c.numChannels, c.blockSize);
+        
+        auto processConverted = [&](juce::AudioBuffer<SampleType>& block)
+        {
+            for (int channel = 0; channel < c.numChannels; ++channel) {
+                auto const* source = block.getReadPointer(channel);
+                auto* destination = converted.getWritePointer(channel);
+                
+                for (int i = 0; i < c.blockSize; ++i)
+                    destination[i] = (float) source[i];
+            }
+            
+            processor.processBlock(converted, midi);
+            
+            for (int channel = 0; channel < c.numChannels; ++channel) {
+                auto const* source = converted.getReadPointer(channel);
+                auto* destination = block.getWritePointer(channel);
+                
+                for (int i = 0; i < c.blockSize; ++i)
+                    destination[i] = (SampleType) source[i];
+            }
+        };
+        
+        struct Pass
+        {
+            juce::int64 ticks = 0;
+            juce::uint64 cycles = 0, allocations = 0;
+        };
+        
+        auto runPass = [&]
+        {
+            for (int channel = 0; channel < c.numChannels; ++channel)
+                region.copyFrom(channel, 0, noise, channel, 0, samplesPerPass);
+            
+            Pass pass;
+            ScopedAllocationCounter allocationCounter;
+            auto const startCycles = cycleCounter.read();
+            auto const startTicks = juce::Time::getHighResolutionTicks();
+            
+            for (auto& block : blocks) {
+                if (c.automated)
+                    for (int band = 0; band < numBands; ++band)
+                        setGain(*parameters[(size_t) band], getAutomatedGain(band, blockIndex));
+                
+                if (c.precision == Precision::convert)
+                    processConverted(*block);
+                else
+                    processor.processBlock(*block, midi);
+                
+                ++blockIndex;
+            }
+            
+            pass.ticks = juce::Time::getHighResolutionTicks() - startTicks;
+            pass.cycles = cycleCounter.read() - startCycles;
+            pass.allocations = allocationCounter.getCount();
+            return pass;
+        };
+        
+        // Settles caches, branch predictors and the worker pool's timing before anything counts
+        runPass();
+        
+        std::vector<double> nsPerSample;
+        juce::uint64 totalCycles = 0, totalAllocations = 0;
+        
+        for (int repeat = 0; repeat < settings.repeats; ++repeat) {
+            juce::int64 ticks = 0;
+            
+            for (int i = 0; i < passesPerRepeat; ++i) {
+                auto const pass = runPass();
+                ticks += pass.ticks;
+                totalCycles += pass.cycles;
+                totalAllocations += pass.allocations;
+            }
+            
+            auto const seconds = juce::Time::highResolutionTicksToSeconds(ticks);
+            nsPerSample.push_back(1.0e9 * seconds / ((double) passesPerRepeat * samplesPerPass * c.numChannels));
+        }
+        
+        processor.releaseResources();
+        
+        std::sort(nsPerSample.begin(), nsPerSample.end());
+        
+        auto const totalSamples = (double) settings.repeats * passesPerRepeat * samplesPerPass * c.numChannels;
+        auto const totalBlocks = (double) settings.repeats * passesPerRepeat * blocksPerPass;
+        
+        Result result;
+        result.nsPerSample = nsPerSample[nsPerSample.size() / 2];
+        result.minNsPerSample = nsPerSample.front();
+        result.cyclesPerSample = (double) totalCycles / totalSamples;
+        result.cyclesCounted = ! c.multithreaded || cycleCounter.countsThreads();
+        result.allocations = totalAllocations;
+        result.allocationsPerBlock = (double) totalAllocations / totalBlocks;
+        result.realtimeFactor = 1.0e9 / (result.nsPerSample * c.numChannels * c.sampleRate);
+        return result;
+    }
+    
+    juce::var toVar(const Case& c, const Result& r)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("key", getKey(c));
+        object->setProperty("engine", getEngineName(c.engine));
+        object->setProperty("precision", getPrecisionName(c.precision));
+        object->setProperty("smoothingInterval", c.smoothingInterval);
+        object->setProperty("multithreaded", c.multithreaded);
+        object->setProperty("sampleRate", c.sampleRate);
+        object->setProperty("blockSize", c.blockSize);
+        object->setProperty("channels", c.numChannels);
+        object->setProperty("preset", c.busy ? "busy" : "flat");
+        object->setProperty("gains", c.automated ? "automated" : "static");
+        object->setProperty("nsPerSample", r.nsPerSample);
+        object->setProperty("minNsPerSample", r.minNsPerSample);
+        object->setProperty("cyclesPerSample", r.cyclesCounted ? juce::var(r.cyclesPerSample) : juce::var("n/a"));
+        object->setProperty("allocations", (juce::int64) r.allocations);
+        object->setProperty("allocationsPerBlock", r.allocationsPerBlock);
+        object->setProperty("realtimeFactor", r.realtimeFactor);
+        return juce::var(object);
+    }
+    
+    // key -> ns/sample from a previous run's JSON
+    std::map<juce::String, double> loadBaseline(const juce::File& file)
+    {
+        std::map<juce::String, double> baseline;
+        auto const json = juce::JSON::parse(file.loadFileAsString());
+        
+        if (auto const* results = json["results"].getArray())
+            for (auto const& result : *results)
+                baseline[result["key"].toString()] = (double) result["nsPerSample"];
+        
+        return baseline;
+    }
+    
+    // A comma separated option, or the defaults if it isn't given
+    juce::StringArray getList(const juce::ArgumentList& arguments, const juce::String& option, const juce::String& defaults)
+    {
+        auto const text = arguments.containsOption(option) ? arguments.getValueForOption(option) : defaults;
+        return juce::StringArray::fromTokens(text, ",", {});
+    }
+    
+    void printUsage()
+    {
+        std::cout << "Usage: GraphicEQBenchmarks [options]\n"
+                     "\n"
+                     "Lists are comma separated, the defaults are shown.\n"
+                     "  --engines=cascade,parallel,svf,linear-phase\n"
+                     "  --precision=float                    float, double, convert (double buffers, float processing)\n"
+                     "  --smoothing=0                        smoothing intervals in samples\n"
+                     "  --multithreading=off                 off, on\n"
+                     "  --sample-rates=44100,48000,96000,192000,384000\n"
+                     "  --block-sizes=16,64,256,1024,4096\n"
+                     "  --channels=1,2,8\n"
+                     "  --presets=flat,busy\n"
+                     "  --gains=static,automated\n"
+                     "  --seconds=1                          audio per repeat\n"
+                     "  --repeats=5                          the median is reported\n"
+                     "  --label=<text>                       stored with the results, e.g. a commit\n"
+                     "  --output=<file.json>                 machine-readable results\n"
+                     "  --compare=<file.json>                previous results to compare against\n";
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList arguments(argc, argv);
+    
+    if (arguments.containsOption("--help|-h")) {
+        printUsage();
+        return 0;
+    }
+    
+    Settings settings;
+    
+    if (arguments.containsOption("--seconds"))
+        settings.seconds = juce::jmax(0.01, arguments.getValueForOption("--seconds").getDoubleValue());
+    
+    if (arguments.containsOption("--repeats"))
+        settings.repeats = juce::jmax(1, arguments.getValueForOption("--repeats").getIntValue());
+    
+    for (auto const& engineName : getList(arguments, "--engines", "cascade,parallel,svf,linear-phase")) {
+        if (engineNames.count(engineName) == 0) {
+            std::cerr << "Unknown engine: " << engineName << "\n";
+            return 1;
+        }
+    }
+    
+    for (auto const& precisionName : getList(arguments, "--precision", "float")) {
+        if (precisionNames.count(precisionName) == 0) {
+            std::cerr << "Unknown precision: " << precisionName << "\n";
+            return 1;
+        }
+    }
+    
+    // Every combination of the lists, the first one varying slowest
+    std::vector<Case> cases { Case() };
+    
+    auto addDimension = [&](const juce::String& option, const juce::String& defaults, auto&& apply)
+    {
+        std::vector<Case> combined;
+        
+        for (auto c : cases) {
+            for (auto const& value : getList(arguments, option, defaults)) {
+                apply(c, value);
+                combined.push_back(c);
+            }
+        }
+        
+        cases = std::move(combined);
+    };
+    
+    addDimension("--engines", "cascade,parallel,svf,linear-phase", [](Case& c, const juce::String& value) { c.engine = engineNames.at(value); });
+    addDimension("--precision", "float", [](Case& c, const juce::String& value) { c.precision = precisionNames.at(value); });
+    addDimension("--smoothing", "0", [](Case& c, const juce::String& value) { c.smoothingInterval = juce::jmax(0, value.getIntValue()); });
+    addDimension("--multithreading", "off", [](Case& c, const juce::String& value) { c.multithreaded = value == "on"; });
+    addDimension("--sample-rates", "44100,48000,96000,192000,384000", [](Case& c, const juce::String& value) { c.sampleRate = value.getDoubleValue(); });
+    addDimension("--block-sizes", "16,64,256,1024,4096", [](Case& c, const juce::String& value) { c.blockSize = juce::jmax(1, value.getIntValue()); });
+    addDimension("--channels", "1,2,8", [](Case& c, const juce::String& value) { c.numChannels = juce::jmax(1, value.getIntValue()); });
+    addDimension("--presets", "flat,busy", [](Case& c, const juce::String& value) { c.busy = value == "busy"; });
+    addDimension("--gains", "static,automated", [](Case& c, const juce::String& value) { c.automated = value == "automated"; });
+    
+    // Only says where the cycles come from, every case opens a counter of its own
+    CycleCounter const cycleCounter;
+    std::map<juce::String, double> baseline;
+    
+    if (arguments.containsOption("--compare"))
+        baseline = loadBaseline(arguments.getExistingFileForOption("--compare"));
+    
+    std::cout << juce::SystemStats::getCpuModel() << ", " << numBands << " bands, cycles from " << cycleCounter.getSource()
+              << (ScopedAllocationCounter::isAvailable() ? "" : ", allocations not counted in this build") << "\n\n";
+    
+    juce::Array<juce::var> results;
+    
+    for (auto const& c : cases) {
+        // Convert cases time the host's side too, so their buffers are double like the host's
+        auto const result = c.precision == Precision::float32 ? run<float>(c, settings) : run<double>(c, settings);
+        results.add(toVar(c, result));
+        
+        auto line = getKey(c).paddedRight(' ', 56)
+                  + juce::String(result.nsPerSample, 2).paddedLeft(' ', 9) + " ns/sample"
+                  + (result.cyclesCounted ? juce::String(result.cyclesPerSample, 2) : juce::String("n/a")).paddedLeft(' ', 9) + " cycles/sample"
+                  + juce::String(result.allocationsPerBlock, 2).paddedLeft(' ', 7) + " allocs/block"
+                  + juce::String(result.realtimeFactor, 0).paddedLeft(' ', 9) + "x realtime";
+        
+        auto const previous = baseline.find(getKey(c));
+        
+        if (previous != baseline.end())
+            line << "  " << juce::String(previous->second / result.nsPerSample, 2) << "x vs baseline";
+        
+        std::cout << line << std::endl;
+    }
+    
+    if (arguments.containsOption("--output")) {
+        auto* root = new juce::DynamicObject();
+        root->setProperty("label", arguments.getValueForOption("--label"));
+        root->setProperty("cpu", juce::SystemStats::getCpuModel());
+        root->setProperty("bands", numBands);
+        root->setProperty("cycleCounter", cycleCounter.getSource());
+        root->setProperty("allocationsCounted", ScopedAllocationCounter::isAvailable());
+        root->setProperty("seconds", settings.seconds);
+        root->setProperty("repeats", settings.repeats);
+        root->setProperty("results", results);
+        
+        auto const output = arguments.getFileForOption("--output");
+        
+        if (! output.replaceWithText(juce::JSON::toString(juce::var(root)))) {
+            std::cerr << "Can't write " << output.getFullPathName() << "\n";
+            return 1;
+        }
+    }
+    
+    return 0;
+}
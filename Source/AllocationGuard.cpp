@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    Helpers for catching and counting heap allocations and locks on the
+    audio thread.
+
+  ==============================================================================
+*/
+
+#include "AllocationGuard.h"
+#include "AllocationHooks.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local juce::uint64 lockCount = 0;
+}
+
+void LockCounter::noteLock() noexcept                       { ++lockCount; }
+juce::uint64 LockCounter::getCountOnThisThread() noexcept   { return lockCount; }
+
+namespace
+{
+    thread_local int noAllocationDepth = 0;
+    thread_local juce::uint64 allocationCount = 0;
+    
+    // Set before main() by AllocationHooks.cpp, in the binaries that have it
+    bool hooksInstalled = false;
+}
+
+void* AllocationHooks::allocate(std::size_t size)
+{
+    ++allocationCount;
+    
+    if (noAllocationDepth > 0) {
+        // Drop the guard while asserting, the assertion logging is allowed to allocate
+        auto depth = std::exchange(noAllocationDepth, 0);
+        jassertfalse; // Something allocated inside a ScopedNoAllocation, i.e. on the audio thread
+        noAllocationDepth = depth;
+    }
+    
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    
+    throw std::bad_alloc();
+}
+
+void AllocationHooks::setInstalled() noexcept   { hooksInstalled = true; }
+
+ScopedNoAllocation::ScopedNoAllocation() noexcept     { ++noAllocationDepth; }
+ScopedNoAllocation::~ScopedNoAllocation() noexcept    { --noAllocationDepth; }
+bool ScopedNoAllocation::isActiveOnThisThread() noexcept  { return hooksInstalled && noAllocationDepth > 0; }
+
+ScopedAllocationCounter::ScopedAllocationCounter() noexcept : startCount(allocationCount) {}
+juce::uint64 ScopedAllocationCounter::getCount() const noexcept { return allocationCount - startCount; }
+bool ScopedAllocationCounter::isAvailable() noexcept { return hooksInstalled; }
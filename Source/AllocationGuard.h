@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    Helpers for catching and counting heap allocations and locks on the
+    audio thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    While one of these is alive, any call to the global operator new made on the
+    same thread hits a jassert in debug builds. Put one at the top of processBlock()
+    so that anything which sneaks an allocation into the audio callback gets caught.
+
+    Catching them takes the replacement operator new in AllocationHooks.cpp, which
+    is only active in binaries that own their process and define
+    GRAPHICEQ_CHECK_ALLOCATIONS (debug standalones and tools). Anywhere else, a
+    plugin in a host included, this is just a thread local counter.
+*/
+struct ScopedNoAllocation
+{
+    ScopedNoAllocation() noexcept;
+    ~ScopedNoAllocation() noexcept;
+    
+    static bool isActiveOnThisThread() noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE (ScopedNoAllocation)
+};
+
+/**
+    Counts the calls to the global operator new made on this thread while it's alive.
+    Only binaries with the allocation hooks, built with GRAPHICEQ_CHECK_ALLOCATIONS
+    or GRAPHICEQ_COUNT_ALLOCATIONS (the benchmarks), can count; isAvailable() says
+    whether this one can.
+*/
+struct ScopedAllocationCounter
+{
+    ScopedAllocationCounter() noexcept;
+    
+    juce::uint64 getCount() const noexcept;
+    static bool isAvailable() noexcept;
+    
+private:
+    juce::uint64 startCount;
+    
+    JUCE_DECLARE_NON_COPYABLE (ScopedAllocationCounter)
+};
+
+/**
+    There's no hook for locks like there is for operator new, so code that can block
+    (signalling an event, notifying a thread) calls noteLock() right there. It's a
+    thread local increment, compiled into every build; the processor counts what
+    happens on its own thread during each block.
+*/
+struct LockCounter
+{
+    static void noteLock() noexcept;
+    static juce::uint64 getCountOnThisThread() noexcept;
+};
@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    Replacement global operator new and delete, for ScopedNoAllocation and
+    ScopedAllocationCounter.
+
+  ==============================================================================
+*/
+
+#include "AllocationHooks.h"
+
+#include <cstdlib>
+#include <new>
+
+// Debug builds of the standalone and the tools catch audio thread allocations, the benchmarks count them always
+#ifndef GRAPHICEQ_CHECK_ALLOCATIONS
+ #define GRAPHICEQ_CHECK_ALLOCATIONS 0
+#endif
+
+#ifndef GRAPHICEQ_COUNT_ALLOCATIONS
+ #define GRAPHICEQ_COUNT_ALLOCATIONS 0
+#endif
+
+#if GRAPHICEQ_CHECK_ALLOCATIONS || GRAPHICEQ_COUNT_ALLOCATIONS
+
+namespace
+{
+    struct Installer
+    {
+        Installer() noexcept { AllocationHooks::setInstalled(); }
+    };
+    
+    Installer const installer;
+    
+    void* allocateNoThrow(std::size_t size) noexcept
+    {
+        try { return AllocationHooks::allocate(size); } catch (...) { return nullptr; }
+    }
+}
+
+void* operator new (std::size_t size)                                   { return AllocationHooks::allocate(size); }
+void* operator new[] (std::size_t size)                                 { return AllocationHooks::allocate(size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept   { return allocateNoThrow(size); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow(size); }
+void operator delete (void* ptr) noexcept                               { std::free(ptr); }
+void operator delete[] (void* ptr) noexcept                             { std::free(ptr); }
+void operator delete (void* ptr, std::size_t) noexcept                  { std::free(ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept                { std::free(ptr); }
+
+#endif
@@ -0,0 +1,30 @@
+/*
+  ==============================================================================
+
+    The link between the replacement operator new and AllocationGuard.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+/**
+    AllocationHooks.cpp replaces the global operator new and delete for the whole
+    process, so it's only built into binaries that own their process: the
+    standalone and the command line tools, see CMakeLists.txt. A VST3 or LV2
+    shares its process and allocator with the host, so it only gets the hooks
+    when GRAPHICEQ_CHECK_ALLOCATIONS_IN_PLUGIN asks for them.
+    
+    Deliberately free of JUCE, so that any target can compile it with its own
+    definitions. Implemented in AllocationGuard.cpp.
+*/
+namespace AllocationHooks
+{
+    // Counts the allocation for this thread and asserts inside a ScopedNoAllocation
+    void* allocate(std::size_t size);
+    
+    // Tells ScopedAllocationCounter that allocations are being counted
+    void setInstalled() noexcept;
+}
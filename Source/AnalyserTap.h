@@ -0,0 +1,107 @@
+/*
+  ==============================================================================
+
+    Feeds the editor's spectrum analyser from the audio thread: a mono mix of
+    the signal before and after the EQ, through wait-free FIFOs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    One single-producer, single-consumer juce::AbstractFifo per tap point, over
+    storage allocated up front. The audio thread mixes the block's channels
+    straight into the FIFO, which is about the cost of copying it once, and
+    whatever doesn't fit because the reader fell behind is dropped.
+    
+    Nothing is pushed while the tap is inactive; the analyser activates it for as
+    long as it exists, so with no editor open the audio thread's only cost is
+    checking one flag per push.
+*/
+class AnalyserTap
+{
+public:
+    enum Point
+    {
+        preEQ,
+        postEQ,
+        numPoints
+    };
+    
+    // At 192 kHz that's still more than ten display frames' worth
+    static constexpr int capacity = 1 << 15;
+    
+    AnalyserTap()
+    {
+        for (auto& tap : taps)
+            tap.storage.resize((size_t) capacity);
+    }
+    
+    // Any thread; while inactive the audio thread doesn't touch the FIFOs
+    void setActive(bool shouldBeActive) noexcept { active.store(shouldBeActive, std::memory_order_release); }
+    bool isActive() const noexcept { return active.load(std::memory_order_acquire); }
+    
+    // Audio thread only. Pushes the average of the first numChannels channels.
+    template <typename SampleType>
+    void push(Point point, const juce::AudioBuffer<SampleType>& buffer, int numChannels) noexcept
+    {
+        if (! isActive() || numChannels <= 0)
+            return;
+        
+        auto& tap = taps[(size_t) point];
+        int start1, size1, start2, size2;
+        tap.fifo.prepareToWrite(buffer.getNumSamples(), start1, size1, start2, size2);
+        
+        mixDown(buffer, numChannels, 0, tap.storage.data() + start1, size1);
+        mixDown(buffer, numChannels, size1, tap.storage.data() + start2, size2);
+        
+        tap.fifo.finishedWrite(size1 + size2);
+    }
+    
+    // The analyser's thread only. Copies up to maxSamples of the oldest pushed samples out, returns how many.
+    int read(Point point, float* destination, int maxSamples) noexcept
+    {
+        auto& tap = taps[(size_t) point];
+        int start1, size1, start2, size2;
+        tap.fifo.prepareToRead(maxSamples, start1, size1, start2, size2);
+        
+        std::copy_n(tap.storage.data() + start1, size1, destination);
+        std::copy_n(tap.storage.data() + start2, size2, destination + size1);
+        
+        tap.fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+private:
+    template <typename SampleType>
+    static void mixDown(const juce::AudioBuffer<SampleType>& buffer, int numChannels, int startSample, float* destination, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+        
+        auto const gain = (SampleType) 1 / (SampleType) numChannels;
+        auto const* source = buffer.getReadPointer(0, startSample);
+        
+        for (int i = 0; i < numSamples; ++i)
+            destination[i] = (float) (source[i] * gain);
+        
+        for (int channel = 1; channel < numChannels; ++channel) {
+            source = buffer.getReadPointer(channel, startSample);
+            
+            for (int i = 0; i < numSamples; ++i)
+                destination[i] += (float) (source[i] * gain);
+        }
+    }
+    
+    struct Tap
+    {
+        juce::AbstractFifo fifo {capacity};
+        std::vector<float> storage;
+    };
+    
+    std::array<Tap, numPoints> taps;
+    std::atomic<bool> active {false};
+};
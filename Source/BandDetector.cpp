@@ -0,0 +1,146 @@
+/*
+  ==============================================================================
+
+    Level detectors for the dynamic bands: a band-pass and an envelope follower
+    per band, every band side by side in SIMD lanes.
+
+  ==============================================================================
+*/
+
+#include "BandDetector.h"
+
+namespace
+{
+    // One pole smoothing coefficient that covers about 63% of a step in the given time
+    float getTimeCoefficient(double milliseconds, double sampleRate)
+    {
+        auto const samples = juce::jmax(1.0, 0.001 * milliseconds * sampleRate);
+        return (float) (1.0 - std::exp(-1.0 / samples));
+    }
+}
+
+void BandDetector::prepare(double newSampleRate, const float* bandFreqs, const float* bandQualities, int numBands, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+    
+    auto const numGroups = (numBands + lanesPerGroup - 1) / lanesPerGroup;
+    groups.assign((size_t) numGroups, Group());
+    
+    for (int group = 0; group < numGroups; ++group) {
+        // Lanes past the last band keep all-zero coefficients, and stay silent
+        alignas(Vec) float b0[lanesPerGroup] = {}, b2[lanesPerGroup] = {}, a1[lanesPerGroup] = {}, a2[lanesPerGroup] = {};
+        
+        for (int lane = 0; lane < lanesPerGroup; ++lane) {
+            auto const band = group * lanesPerGroup + lane;
+            
+            if (band >= numBands)
+                break;
+            
+            // Constant 0 dB peak gain band-pass, normalised so a0 is 1
+            auto const frequency = juce::jmin((double) bandFreqs[band], 0.49 * sampleRate);
+            auto const w0 = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+            auto const alpha = std::sin(w0) / (2.0 * (double) bandQualities[band]);
+            auto const a0Inv = 1.0 / (1.0 + alpha);
+            
+            b0[lane] = (float) (alpha * a0Inv);
+            b2[lane] = (float) (-alpha * a0Inv);
+            a1[lane] = (float) (-2.0 * std::cos(w0) * a0Inv);
+            a2[lane] = (float) ((1.0 - alpha) * a0Inv);
+        }
+        
+        auto& g = groups[(size_t) group];
+        g.b0 = Vec::fromRawArray(b0);
+        g.b2 = Vec::fromRawArray(b2);
+        g.a1 = Vec::fromRawArray(a1);
+        g.a2 = Vec::fromRawArray(a2);
+    }
+    
+    mono.resize((size_t) juce::jmax(1, maximumBlockSize));
+    
+    // Forces the time coefficients to be redone for the new rate
+    auto const attackTime = attackMilliseconds, releaseTime = releaseMilliseconds;
+    attackMilliseconds = releaseMilliseconds = -1.0f;
+    setTimes(attackTime, releaseTime);
+    
+    reset();
+}
+
+void BandDetector::reset()
+{
+    for (auto& group : groups) {
+        group.s1 = Vec::expand(0.0f);
+        group.s2 = Vec::expand(0.0f);
+        group.envelope = Vec::expand(0.0f);
+    }
+}
+
+void BandDetector::setTimes(float newAttackMilliseconds, float newReleaseMilliseconds) noexcept
+{
+    if (newAttackMilliseconds == attackMilliseconds && newReleaseMilliseconds == releaseMilliseconds)
+        return;
+    
+    attackMilliseconds = newAttackMilliseconds;
+    releaseMilliseconds = newReleaseMilliseconds;
+    
+    attack = Vec::expand(getTimeCoefficient(attackMilliseconds, sampleRate));
+    release = Vec::expand(getTimeCoefficient(releaseMilliseconds, sampleRate));
+}
+
+template <typename SampleType>
+void BandDetector::process(const juce::dsp::AudioBlock<SampleType>& block) noexcept
+{
+    auto const numChannels = (int) block.getNumChannels();
+    auto const numSamples = (int) block.getNumSamples();
+    
+    if (numChannels == 0 || groups.empty())
+        return;
+    
+    auto const scale = (SampleType) 1 / (SampleType) numChannels;
+    auto const zero = Vec::expand(0.0f);
+    
+    for (int start = 0; start < numSamples; start += (int) mono.size()) {
+        auto const length = juce::jmin((int) mono.size(), numSamples - start);
+        auto* x = mono.data();
+        
+        auto const* source = block.getChannelPointer(0) + start;
+        
+        for (int i = 0; i < length; ++i)
+            x[i] = (float) (source[i] * scale);
+        
+        for (int channel = 1; channel < numChannels; ++channel) {
+            source = block.getChannelPointer((size_t) channel) + start;
+            
+            for (int i = 0; i < length; ++i)
+                x[i] += (float) (source[i] * scale);
+        }
+        
+        // One group at a time, so its state stays in registers for the whole chunk
+        for (auto& group : groups) {
+            auto s1 = group.s1, s2 = group.s2, envelope = group.envelope;
+            
+            for (int i = 0; i < length; ++i) {
+                auto const input = Vec::expand(x[i]);
+                auto const y = group.b0 * input + s1;
+                s1 = s2 - group.a1 * y;
+                s2 = group.b2 * input - group.a2 * y;
+                
+                // Rising lanes move by the attack coefficient, falling ones by the release
+                auto const difference = Vec::abs(y) - envelope;
+                envelope += attack * Vec::max(difference, zero) + release * Vec::min(difference, zero);
+            }
+            
+            group.s1 = s1;
+            group.s2 = s2;
+            group.envelope = envelope;
+        }
+    }
+}
+
+float BandDetector::getLevelDecibels(int bandIndex) const noexcept
+{
+    auto const& group = groups[(size_t) (bandIndex / lanesPerGroup)];
+    return juce::Decibels::gainToDecibels(group.envelope.get((size_t) (bandIndex % lanesPerGroup)), floorDecibels);
+}
+
+template void BandDetector::process<float>(const juce::dsp::AudioBlock<float>&) noexcept;
+template void BandDetector::process<double>(const juce::dsp::AudioBlock<double>&) noexcept;
@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    Level detectors for the dynamic bands: a band-pass and an envelope follower
+    per band, every band side by side in SIMD lanes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    The level a dynamic band reacts to is its own part of the input: a mono mix
+    of the channels (so every channel gets the same gain) through a constant
+    0 dB peak band-pass at the band's frequency and Q, followed by a peak
+    envelope with separate attack and release.
+    
+    Unlike SIMDCascade, the lanes here hold bands rather than channels: there is
+    only one detector signal, but every band filters it. The band-passes are
+    transposed direct form II like the cascade's sections, and the follower
+    moves towards the rectified output by the attack or the release coefficient
+    depending on the sign of the difference, with no branches per lane. Twelve
+    bands are three groups of four floats on SSE/NEON, so all of it costs about
+    as much per sample as three biquads.
+    
+    Detection always runs in float, whatever the processing precision; a level
+    to compare against a threshold doesn't need more.
+*/
+class BandDetector
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+    
+    // Allocates everything for the given bands, call from prepareToPlay
+    void prepare(double sampleRate, const float* bandFreqs, const float* bandQualities, int numBands, int maximumBlockSize);
+    void reset();
+    
+    // Audio thread; only recomputes the coefficients when a time actually changed
+    void setTimes(float attackMilliseconds, float releaseMilliseconds) noexcept;
+    
+    // Feeds the detectors with a block of input, before it's filtered
+    template <typename SampleType>
+    void process(const juce::dsp::AudioBlock<SampleType>& block) noexcept;
+    
+    // Peak level of the band's part of the input, in dBFS
+    float getLevelDecibels(int bandIndex) const noexcept;
+    
+    static constexpr float floorDecibels = -120.0f;
+
+private:
+    struct Group
+    {
+        Vec b0, b2, a1, a2;
+        Vec s1, s2;
+        Vec envelope;
+    };
+    
+    double sampleRate = 44100.0;
+    std::vector<Group> groups;
+    std::vector<float> mono;
+    
+    float attackMilliseconds = -1.0f, releaseMilliseconds = -1.0f;
+    Vec attack = Vec::expand(1.0f), release = Vec::expand(1.0f);
+};
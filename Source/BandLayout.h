@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    Compile-time band layouts: frequencies, Qs, parameter IDs and labels.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+
+/**
+    Everything that differs between band counts lives in one specialisation, as
+    static constexpr tables, so nothing about the layout is stored per instance.
+    The processor, the parameter layout, the coefficient updates and the editor
+    are all generated from whichever layout GRAPHICEQ_NUM_BANDS picks (12 unless
+    the build defines it, e.g. in the Projucer's preprocessor definitions).
+
+    Parameter IDs end up in saved sessions, so an existing layout's IDs must
+    never change.
+*/
+template <int NumBands>
+struct BandLayout;
+
+// The original layout
+template <>
+struct BandLayout<12>
+{
+    static constexpr int numBands = 12;
+    static constexpr char const* title = "12 Band Graphic EQ";
+
+    static constexpr std::array<float, numBands> freqs {20.f, 32.f, 64.f, 125.f, 250.f, 500.f, 1000.f, 2000.f, 4000.f, 8000.f, 16000.f, 20000.f};
+    static constexpr std::array<float, numBands> qualities {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+
+    static constexpr std::array<char const*, numBands> names {"Band 20", "Band 32", "Band 64", "Band 125",
+                                                              "Band 250", "Band 500", "Band 1k", "Band 2k",
+                                                              "Band 4k", "Band 8k", "Band 16k", "Band 20k"};
+
+    static constexpr std::array<char const*, numBands> labels {"20", "32", "64", "125", "250", "500",
+                                                               "1k", "2k", "4k", "8k", "16k", "20k"};
+};
+
+// ISO octave bands, Q = sqrt(2) for a one octave bandwidth
+template <>
+struct BandLayout<10>
+{
+    static constexpr int numBands = 10;
+    static constexpr char const* title = "10 Band Graphic EQ";
+
+    static constexpr std::array<float, numBands> freqs {31.5f, 63.f, 125.f, 250.f, 500.f, 1000.f, 2000.f, 4000.f, 8000.f, 16000.f};
+    static constexpr std::array<float, numBands> qualities {1.414f, 1.414f, 1.414f, 1.414f, 1.414f, 1.414f, 1.414f, 1.414f, 1.414f, 1.414f};
+
+    static constexpr std::array<char const*, numBands> names {"Band 31.5", "Band 63", "Band 125", "Band 250", "Band 500",
+                                                              "Band 1k", "Band 2k", "Band 4k", "Band 8k", "Band 16k"};
+
+    static constexpr std::array<char const*, numBands> labels {"31.5", "63", "125", "250", "500", "1k", "2k", "4k", "8k", "16k"};
+};
+
+// ISO 2/3 octave bands, Q = 2.145
+template <>
+struct BandLayout<15>
+{
+    static constexpr int numBands = 15;
+    static constexpr char const* title = "15 Band Graphic EQ";
+
+    static constexpr std::array<float, numBands> freqs {25.f, 40.f, 63.f, 100.f, 160.f, 250.f, 400.f, 630.f,
+                                                        1000.f, 1600.f, 2500.f, 4000.f, 6300.f, 10000.f, 16000.f};
+    static constexpr std::array<float, numBands> qualities {2.145f, 2.145f, 2.145f, 2.145f, 2.145f, 2.145f, 2.145f, 2.145f,
+                                                            2.145f, 2.145f, 2.145f, 2.145f, 2.145f, 2.145f, 2.145f};
+
+    static constexpr std::array<char const*, numBands> names {"Band 25", "Band 40", "Band 63", "Band 100", "Band 160",
+                                                              "Band 250", "Band 400", "Band 630", "Band 1k", "Band 1.6k",
+                                                              "Band 2.5k", "Band 4k", "Band 6.3k", "Band 10k", "Band 16k"};
+
+    static constexpr std::array<char const*, numBands> labels {"25", "40", "63", "100", "160", "250", "400", "630",
+                                                               "1k", "1.6k", "2.5k", "4k", "6.3k", "10k", "16k"};
+};
+
+// ISO 1/3 octave bands, Q = 4.318
+template <>
+struct BandLayout<31>
+{
+    static constexpr int numBands = 31;
+    static constexpr char const* title = "31 Band Graphic EQ";
+
+    static constexpr std::array<float, numBands> freqs {20.f, 25.f, 31.5f, 40.f, 50.f, 63.f, 80.f, 100.f,
+                                                        125.f, 160.f, 200.f, 250.f, 315.f, 400.f, 500.f, 630.f,
+                                                        800.f, 1000.f, 1250.f, 1600.f, 2000.f, 2500.f, 3150.f, 4000.f,
+                                                        5000.f, 6300.f, 8000.f, 10000.f, 12500.f, 16000.f, 20000.f};
+    static constexpr std::array<float, numBands> qualities {4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f,
+                                                            4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f,
+                                                            4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f,
+                                                            4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f, 4.318f};
+
+    static constexpr std::array<char const*, numBands> names {"Band 20", "Band 25", "Band 31.5", "Band 40", "Band 50", "Band 63",
+                                                              "Band 80", "Band 100", "Band 125", "Band 160", "Band 200", "Band 250",
+                                                              "Band 315", "Band 400", "Band 500", "Band 630", "Band 800", "Band 1k",
+                                                              "Band 1.25k", "Band 1.6k", "Band 2k", "Band 2.5k", "Band 3.15k", "Band 4k",
+                                                              "Band 5k", "Band 6.3k", "Band 8k", "Band 10k", "Band 12.5k", "Band 16k",
+                                                              "Band 20k"};
+
+    static constexpr std::array<char const*, numBands> labels {"20", "25", "31.5", "40", "50", "63", "80", "100",
+                                                               "125", "160", "200", "250", "315", "400", "500", "630",
+                                                               "800", "1k", "1.25k", "1.6k", "2k", "2.5k", "3.15k", "4k",
+                                                               "5k", "6.3k", "8k", "10k", "12.5k", "16k", "20k"};
+};
+
+#ifndef GRAPHICEQ_NUM_BANDS
+ #define GRAPHICEQ_NUM_BANDS 12
+#endif
+
+using Bands = BandLayout<GRAPHICEQ_NUM_BANDS>;
@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    A small pool of real-time worker threads for spreading independent channel
+    groups of one processBlock() call over several cores.
+
+  ==============================================================================
+*/
+
+#include "ChannelWorkerPool.h"
+#include "AllocationGuard.h"
+
+#include <thread>
+
+namespace
+{
+    uint64_t makeBatch(uint32_t generation, int numTasks, int nextTask) noexcept
+    {
+        return ((uint64_t) generation << 32) | ((uint64_t) (numTasks & 0xffff) << 16) | (uint64_t) (nextTask & 0xffff);
+    }
+    
+    uint32_t getGeneration(uint64_t b) noexcept  { return (uint32_t) (b >> 32); }
+    int getNumTasks(uint64_t b) noexcept         { return (int) ((b >> 16) & 0xffff); }
+    int getNextTask(uint64_t b) noexcept         { return (int) (b & 0xffff); }
+    
+    // Every so often the mode that isn't currently winning is tried again, in case things changed
+    constexpr int blocksBetweenProbes = 64;
+    constexpr double measurementSmoothing = 0.1;
+    
+    // Parallel runs in a row that may be dropped for having woken the workers, before that counts as their cost
+    constexpr int maxDiscardedParallelRuns = 4;
+}
+
+//==============================================================================
+class ChannelWorkerPool::Worker : public juce::Thread
+{
+public:
+    Worker(ChannelWorkerPool& p, int index) : juce::Thread("EQ worker " + juce::String(index)), pool(p) {}
+    
+    void run() override
+    {
+        // Flush to zero is per thread, and the tasks have to run exactly as they would on the audio thread
+        juce::ScopedNoDenormals noDenormals;
+        
+        auto lastWorkTime = juce::Time::getHighResolutionTicks();
+        
+        while (! threadShouldExit()) {
+            if (pool.runOneTask()) {
+                lastWorkTime = juce::Time::getHighResolutionTicks();
+                continue;
+            }
+            
+            if (juce::Time::getHighResolutionTicks() - lastWorkTime < pool.spinTicks.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+                continue;
+            }
+            
+            // Idle for longer than a block: stop burning the core until run() wakes us
+            pool.numParkedWorkers.fetch_add(1);
+            
+            if (! pool.hasTasksToClaim())
+                wakeUp.wait(100);
+            
+            pool.numParkedWorkers.fetch_sub(1);
+            lastWorkTime = juce::Time::getHighResolutionTicks();
+        }
+    }
+    
+    juce::WaitableEvent wakeUp;
+
+private:
+    ChannelWorkerPool& pool;
+};
+
+//==============================================================================
+ChannelWorkerPool::ChannelWorkerPool(int numWorkers)
+{
+    setSpinTime(0.002);
+    
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        workers.back()->startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(10));
+    }
+}
+
+ChannelWorkerPool::~ChannelWorkerPool()
+{
+    for (auto& worker : workers) {
+        worker->signalThreadShouldExit();
+        worker->wakeUp.signal();
+    }
+    
+    for (auto& worker : workers)
+        worker->stopThread(1000);
+}
+
+void ChannelWorkerPool::setSpinTime(double seconds)
+{
+    spinTicks = (int64_t) (seconds * (double) juce::Time::getHighResolutionTicksPerSecond());
+}
+
+void ChannelWorkerPool::run(int numTasks, int numSamples, Task task, void* context) noexcept
+{
+    jassert(numTasks <= 0xffff);
+    
+    if (numTasks <= 0)
+        return;
+    
+    if (workers.empty() || numTasks == 1) {
+        runSerially(numTasks, task, context);
+        return;
+    }
+    
+    auto& estimate = estimates[(size_t) getBlockSizeBucket(numSamples)];
+    bool const parallel = shouldRunInParallel(estimate);
+    bool wokeWorkers = false;
+    auto const start = juce::Time::getHighResolutionTicks();
+    
+    if (parallel)
+        wokeWorkers = runInParallel(numTasks, task, context);
+    else
+        runSerially(numTasks, task, context);
+    
+    auto const ticksPerSample = (double) (juce::Time::getHighResolutionTicks() - start) / (double) juce::jmax(1, numSamples);
+    
+    // Mostly the workers' wake-up; they spin now, so the next block of this size measures them properly
+    if (parallel) {
+        if (wokeWorkers && ++estimate.discardedParallelRuns <= maxDiscardedParallelRuns)
+            return;
+        
+        estimate.discardedParallelRuns = 0;
+    }
+    
+    auto& ticks = parallel ? estimate.parallelTicksPerSample : estimate.serialTicksPerSample;
+    ticks = ticks == 0.0 ? ticksPerSample : ticks + measurementSmoothing * (ticksPerSample - ticks);
+}
+
+int ChannelWorkerPool::getBlockSizeBucket(int numSamples) noexcept
+{
+    int bucket = 0;
+    
+    while (bucket < numBlockSizeBuckets - 1 && (2 << bucket) <= numSamples)
+        ++bucket;
+    
+    return bucket;
+}
+
+bool ChannelWorkerPool::shouldRunInParallel(Estimate& estimate) noexcept
+{
+    // Try each mode at least once before trusting the numbers, and finish a probe whose run was dropped
+    if (estimate.serialTicksPerSample == 0.0)
+        return false;
+    
+    if (estimate.parallelTicksPerSample == 0.0 || estimate.discardedParallelRuns > 0)
+        return true;
+    
+    bool const parallelIsFaster = estimate.parallelTicksPerSample < estimate.serialTicksPerSample;
+    
+    if (++estimate.blocksSinceProbe >= blocksBetweenProbes) {
+        estimate.blocksSinceProbe = 0;
+        return ! parallelIsFaster;
+    }
+    
+    return parallelIsFaster;
+}
+
+void ChannelWorkerPool::runSerially(int numTasks, Task task, void* context) noexcept
+{
+    for (int i = 0; i < numTasks; ++i)
+        task(context, i);
+}
+
+bool ChannelWorkerPool::runInParallel(int numTasks, Task task, void* context) noexcept
+{
+    // Nothing from the previous batch can still be running here, so these are safe to overwrite
+    currentTask = task;
+    currentContext = context;
+    tasksRemaining.store(numTasks, std::memory_order_relaxed);
+    
+    auto const generation = getGeneration(batch.load(std::memory_order_relaxed)) + 1;
+    batch.store(makeBatch(generation, numTasks, 0));
+    
+    // Only happens on the first block after the workers went idle; signalling takes the event's lock
+    bool const wokeWorkers = numParkedWorkers.load() > 0;
+    
+    if (wokeWorkers) {
+        LockCounter::noteLock();
+        
+        for (auto& worker : workers)
+            worker->wakeUp.signal();
+    }
+    
+    // The audio thread does its share too
+    while (runOneTask()) {}
+    
+    while (tasksRemaining.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+    
+    return wokeWorkers;
+}
+
+bool ChannelWorkerPool::hasTasksToClaim() const noexcept
+{
+    auto const current = batch.load();
+    return getNextTask(current) < getNumTasks(current);
+}
+
+bool ChannelWorkerPool::runOneTask() noexcept
+{
+    auto current = batch.load(std::memory_order_acquire);
+    
+    for (;;) {
+        auto const taskIndex = getNextTask(current);
+        
+        if (taskIndex >= getNumTasks(current))
+            return false;
+        
+        // The claim only succeeds if the batch is still the one we read, generation included
+        if (batch.compare_exchange_weak(current,
+                                        makeBatch(getGeneration(current), getNumTasks(current), taskIndex + 1),
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire))
+        {
+            currentTask(currentContext, taskIndex);
+            tasksRemaining.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
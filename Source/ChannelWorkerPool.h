@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    A small pool of real-time worker threads for spreading independent channel
+    groups of one processBlock() call over several cores.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    The workers are started up front and never allocate or take a lock while
+    working. Each run() publishes a batch of tasks through a single atomic word
+    (generation, task count and next task index packed together), the workers and
+    the calling audio thread claim tasks from it with compare-and-swap, and run()
+    returns once a countdown of unfinished tasks reaches zero.
+    
+    Between blocks the workers spin for up to one block period so that the next
+    batch is picked up immediately. If nothing arrives for longer than that they
+    park on an event, and the first run() after that wakes them up.
+    
+    Whether splitting the work is worth it depends on the block size and on how
+    much work there is per task, so run() also times itself and only goes wide
+    while that measures faster than doing everything on the calling thread.
+    Each power of two of block sizes keeps its own estimates, since a host can
+    send blocks of very different sizes and the fixed cost of going wide only
+    pays off for the longer ones. Workers that had to be woken up make a
+    parallel run look slower than it is once they spin, so such a run isn't
+    counted and the next block of that size tries again, unless waking them is
+    what every parallel run costs anyway.
+*/
+class ChannelWorkerPool
+{
+public:
+    using Task = void (*)(void* context, int taskIndex);
+    
+    explicit ChannelWorkerPool(int numWorkers);
+    ~ChannelWorkerPool();
+    
+    // How long workers keep spinning for the next block before parking, call from prepareToPlay
+    void setSpinTime(double seconds);
+    
+    // Runs task(context, i) for every i in [0, numTasks) and returns when they're all done
+    void run(int numTasks, int numSamples, Task task, void* context) noexcept;
+    
+    int getNumWorkers() const { return (int) workers.size(); }
+
+private:
+    class Worker;
+    
+    void runSerially(int numTasks, Task task, void* context) noexcept;
+    bool runInParallel(int numTasks, Task task, void* context) noexcept;
+    bool runOneTask() noexcept;
+    bool hasTasksToClaim() const noexcept;
+    
+    // Self-measurement, audio thread only: average cost per sample of each way of running a batch
+    struct Estimate
+    {
+        double serialTicksPerSample = 0.0, parallelTicksPerSample = 0.0;
+        int blocksSinceProbe = 0;
+        int discardedParallelRuns = 0;
+    };
+    
+    static constexpr int numBlockSizeBuckets = 16;
+    static int getBlockSizeBucket(int numSamples) noexcept;
+    bool shouldRunInParallel(Estimate& estimate) noexcept;
+    
+    // generation (32 bits) | number of tasks (16 bits) | next unclaimed task (16 bits)
+    std::atomic<uint64_t> batch {0};
+    std::atomic<int> tasksRemaining {0};
+    std::atomic<int> numParkedWorkers {0};
+    std::atomic<int64_t> spinTicks {0};
+    
+    // Only written by run() while no task of the previous batch is outstanding
+    Task currentTask = nullptr;
+    void* currentContext = nullptr;
+    
+    std::vector<std::unique_ptr<Worker>> workers;
+    
+    // One per power of two of block sizes, the last one takes everything longer
+    std::array<Estimate, numBlockSizeBuckets> estimates;
+    
+    JUCE_DECLARE_NON_COPYABLE (ChannelWorkerPool)
+};
@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    Hands complete coefficient banks from any thread to the audio thread
+    without locks on the audio side and without ever freeing memory there.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    A triple buffer of banks. Writers fill a bank nobody else can see, then swap it
+    in with a single atomic exchange; the audio thread swaps the newest one out at the
+    start of a block. Whatever bank the audio thread lets go of simply becomes the
+    writers' next scratch bank, so nothing is ever allocated or freed after
+    construction, and the audio thread only ever sees whole banks.
+
+    If several banks are published between two blocks, only the newest is picked up.
+    Writers are serialised among themselves with a spin lock, the audio thread never
+    touches it.
+*/
+template <typename Bank>
+class CoefficientExchange
+{
+public:
+    // Writer side, any thread but the audio thread. fill(Bank&) must write the whole bank.
+    template <typename FillFunction>
+    void publish(FillFunction&& fill)
+    {
+        const juce::SpinLock::ScopedLockType sl(writerLock);
+        
+        fill(banks[(size_t) writeIndex]);
+        writeIndex = sharedIndex.exchange(writeIndex | newDataFlag, std::memory_order_acq_rel) & indexMask;
+    }
+    
+    // Audio thread only. Returns the newest bank if one was published since the last call, otherwise nullptr.
+    // The bank stays valid until the next call.
+    const Bank* pickUpLatest() noexcept
+    {
+        if ((sharedIndex.load(std::memory_order_acquire) & newDataFlag) == 0)
+            return nullptr;
+        
+        readIndex = sharedIndex.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return &banks[(size_t) readIndex];
+    }
+    
+private:
+    static constexpr int indexMask = 3, newDataFlag = 4;
+    
+    std::array<Bank, 3> banks;
+    std::atomic<int> sharedIndex {1};
+    int writeIndex = 0; // owned by the writers
+    int readIndex = 2;  // owned by the audio thread
+    
+    juce::SpinLock writerLock;
+};
@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+    Linear phase version of the band curve: a symmetric FIR designed on a
+    background thread and run through partitioned FFT convolution.
+
+  ==============================================================================
+*/
+
+#include "LinearPhaseEQ.h"
+
+namespace
+{
+    // Partition size of the convolvers' zero latency head; the tail uses larger partitions
+    constexpr int convolutionHeadSize = 512;
+    
+    // How often the designer looks for gain changes, the audio thread never wakes it
+    constexpr int gainPollIntervalMs = 10;
+}
+
+LinearPhaseEQ::LinearPhaseEQ()
+    : juce::Thread("Linear phase EQ designer")
+{
+}
+
+LinearPhaseEQ::~LinearPhaseEQ()
+{
+    stopThread(2000);
+}
+
+void LinearPhaseEQ::prepare(const juce::dsp::ProcessSpec& spec, const float* bandFreqs, const float* bandQualities,
+                           const float* gainsInDecibels, int newNumBands)
+{
+    // The designer reads everything set up here, so it sits this out
+    stopThread(2000);
+    
+    sampleRate = spec.sampleRate;
+    freqs = bandFreqs;
+    qualities = bandQualities;
+    
+    if (newNumBands != numBands || requestedGains == nullptr) {
+        numBands = newNumBands;
+        requestedGains.reset(new std::atomic<float>[(size_t) numBands]);
+    }
+    
+    for (int i = 0; i < numBands; ++i)
+        requestedGains[(size_t) i] = gainsInDecibels[i];
+    
+    convolvers.clear();
+    
+    if (! messageQueue.has_value())
+        messageQueue.emplace();
+    
+    for (int firstChannel = 0; firstChannel < (int) spec.numChannels; firstChannel += 2)
+        convolvers.push_back(std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::NonUniform { convolutionHeadSize }, **messageQueue));
+    
+    // Designed right here and loaded before the convolvers are prepared, which installs the kernel
+    // outright instead of crossfading to it from a pass-through: the very first block is already filtered
+    designPending = false;
+    designKernel();
+    
+    for (size_t pair = 0; pair < convolvers.size(); ++pair) {
+        auto const numChannels = juce::jmin(2, (int) spec.numChannels - 2 * (int) pair);
+        convolvers[pair]->prepare({ spec.sampleRate, spec.maximumBlockSize, (juce::uint32) numChannels });
+    }
+    
+    // Installed outright, and the caller reports its latency itself
+    installedKernelLength = announcedKernelLength = loadedKernelLength;
+    
+    startThread(juce::Thread::Priority::low);
+}
+
+void LinearPhaseEQ::reset()
+{
+    for (auto& convolver : convolvers)
+        convolver->reset();
+}
+
+void LinearPhaseEQ::release()
+{
+    stopThread(2000);
+    convolvers.clear();
+    messageQueue.reset();
+    installedKernelLength = 0;
+}
+
+void LinearPhaseEQ::setGains(const float* gainsInDecibels) noexcept
+{
+    bool changed = false;
+    
+    for (int i = 0; i < numBands; ++i) {
+        if (requestedGains[(size_t) i].load(std::memory_order_relaxed) != gainsInDecibels[i]) {
+            requestedGains[(size_t) i].store(gainsInDecibels[i], std::memory_order_relaxed);
+            changed = true;
+        }
+    }
+    
+    // Picked up on the designer's next poll
+    if (changed)
+        designPending = true;
+}
+
+void LinearPhaseEQ::setKernelLength(int numSamples)
+{
+    kernelLength = juce::jlimit(minKernelLength, maxKernelLength, juce::nextPowerOfTwo(numSamples));
+    
+    designPending = true;
+    notify();
+}
+
+void LinearPhaseEQ::process(const juce::dsp::AudioBlock<float>& block) noexcept
+{
+    auto const numChannels = (int) block.getNumChannels();
+    
+    for (int pair = 0; pair < (int) convolvers.size() && 2 * pair < numChannels; ++pair) {
+        auto channels = block.getSubsetChannelBlock((size_t) (2 * pair), (size_t) juce::jmin(2, numChannels - 2 * pair));
+        convolvers[(size_t) pair]->process(juce::dsp::ProcessContextReplacing<float>(channels));
+    }
+    
+    // A newly loaded kernel is swapped in during process(), so this is where its length shows up
+    if (! convolvers.empty())
+        installedKernelLength.store(convolvers.front()->getCurrentIRSize(), std::memory_order_relaxed);
+}
+
+void LinearPhaseEQ::run()
+{
+    while (! threadShouldExit()) {
+        // Also how a kernel of a new length on its way to the audio thread gets noticed
+        wait(gainPollIntervalMs);
+        
+        // Gain changes that arrive while a kernel is being designed fold into the next one
+        while (designPending.exchange(false) && ! threadShouldExit())
+            designKernel();
+        
+        if (loadedKernelLength != announcedKernelLength && installedKernelLength.load() == loadedKernelLength) {
+            announcedKernelLength = loadedKernelLength;
+            
+            if (onLatencyChanged != nullptr)
+                onLatencyChanged();
+        }
+    }
+}
+
+void LinearPhaseEQ::designKernel()
+{
+    auto const length = kernelLength.load();
+    auto const twoPi = juce::MathConstants<double>::twoPi;
+    
+    std::vector<std::array<double, 6>> bands((size_t) numBands);
+    
+    for (int i = 0; i < numBands; ++i) {
+        auto const gain = juce::Decibels::decibelsToGain((double) requestedGains[(size_t) i].load());
+        bands[(size_t) i] = juce::dsp::IIR::ArrayCoefficients<double>::makePeakFilter(sampleRate, freqs[i], qualities[i], gain);
+    }
+    
+    // The curve's magnitude on the FFT grid, with zero phase (interleaved real, imaginary up to Nyquist)
+    std::vector<float> spectrum((size_t) (2 * length), 0.0f);
+    
+    for (int bin = 0; bin <= length / 2; ++bin) {
+        auto const w = std::polar(1.0, -twoPi * bin / length);
+        double magnitude = 1.0;
+        
+        for (auto const& c : bands)
+            magnitude *= std::abs((c[0] + w * (c[1] + w * c[2])) / (c[3] + w * (c[4] + w * c[5])));
+        
+        spectrum[(size_t) (2 * bin)] = (float) magnitude;
+    }
+    
+    auto const dcGain = (double) spectrum[0];
+    
+    juce::dsp::FFT fft(juce::roundToInt(std::log2(length)));
+    fft.performRealOnlyInverseTransform(spectrum.data());
+    
+    // Zero phase puts the peak at sample 0; rotating by half the length centres it, a Hann window tapers the ends
+    juce::AudioBuffer<float> kernel(1, length);
+    auto* h = kernel.getWritePointer(0);
+    double sum = 0.0;
+    
+    for (int n = 0; n < length; ++n) {
+        auto const window = 0.5 - 0.5 * std::cos(twoPi * n / length);
+        h[n] = (float) (spectrum[(size_t) ((n + length / 2) % length)] * window);
+        sum += h[n];
+    }
+    
+    // Pins the DC gain to the curve's, which also makes the result independent of the FFT's scaling
+    if (sum != 0.0)
+        kernel.applyGain((float) (dcGain / sum));
+    
+    for (size_t i = 0; i < convolvers.size(); ++i) {
+        juce::AudioBuffer<float> copy;
+        copy.makeCopyOf(kernel);
+        
+        // Loaded in the background by the convolver itself, then crossfaded in on the audio thread
+        convolvers[i]->loadImpulseResponse(std::move(copy),
+                                           sampleRate,
+                                           juce::dsp::Convolution::Stereo::no,
+                                           juce::dsp::Convolution::Trim::no,
+                                           juce::dsp::Convolution::Normalise::no);
+    }
+    
+    loadedKernelLength = length;
+}
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    Linear phase version of the band curve: a symmetric FIR designed on a
+    background thread and run through partitioned FFT convolution.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Same magnitude response as the IIR engines, with none of their phase shift.
+    
+    The kernel is designed by frequency sampling: the product of the bands'
+    peak filter magnitudes is sampled on an FFT grid of kernelLength bins, turned
+    into a zero phase impulse response with an inverse FFT, centred and windowed.
+    That takes an FFT and a few hundred thousand complex evaluations, so it runs
+    on a thread of its own whenever the gains change. The audio thread only ever
+    copies gains into atomics, and the designer polls for them, so automation
+    never has the audio thread take a lock.
+    
+    juce::dsp::Convolution does the rest: non-uniformly partitioned, so a long
+    kernel stays affordable without adding latency of its own, and it swaps
+    freshly loaded kernels in with a short crossfade, without blocking. It runs
+    at most two channels, so wider layouts get one convolver per channel pair.
+    Every convolver in the process hands its kernels over through one shared
+    message queue, so there's one loading thread however many instances run.
+    
+    Nothing is allocated and no thread runs, this one's or the queue's, until
+    prepare(); the processor only prepares this engine once it's selected.
+    
+    The kernel is centred, which delays everything by half its length; that's the
+    latency to report. Longer kernels resolve the low bands better, at the cost
+    of more latency and CPU.
+*/
+class LinearPhaseEQ : private juce::Thread
+{
+public:
+    LinearPhaseEQ();
+    ~LinearPhaseEQ() override;
+    
+    // Call from prepareToPlay; the band tables must outlive this object. The kernel for the given gains
+    // is in place from the first block on.
+    void prepare(const juce::dsp::ProcessSpec& spec, const float* bandFreqs, const float* bandQualities,
+                 const float* gainsInDecibels, int numBands);
+    void reset();
+    
+    // Stops the designer and frees the convolvers, call when the engine isn't going to be used
+    void release();
+    
+    // Audio thread, lock free: asks for a new kernel if any gain differs from the last request
+    void setGains(const float* gainsInDecibels) noexcept;
+    
+    void process(const juce::dsp::AudioBlock<float>& block) noexcept;
+    
+    // A power of two, clamped to the supported range; takes effect with the next kernel
+    void setKernelLength(int numSamples);
+    int getKernelLength() const noexcept { return kernelLength.load(); }
+    
+    // Half the length of the kernel the audio thread runs, not of one that's still on its way
+    int getLatencySamples() const noexcept { return installedKernelLength.load() / 2; }
+    
+    // Called on the designer thread once a kernel of a new length has reached the audio thread,
+    // i.e. when getLatencySamples() changed. Set it before prepare().
+    std::function<void()> onLatencyChanged;
+    
+    static constexpr int minKernelLength = 1024;
+    static constexpr int maxKernelLength = 65536;
+    static constexpr int defaultKernelLength = 8192;
+
+private:
+    void run() override;
+    void designKernel();
+    
+    double sampleRate = 44100.0;
+    const float* freqs = nullptr;
+    const float* qualities = nullptr;
+    int numBands = 0;
+    
+    std::atomic<int> kernelLength {defaultKernelLength};
+    std::unique_ptr<std::atomic<float>[]> requestedGains;
+    std::atomic<bool> designPending {false};
+    
+    // Set by the audio thread from what its convolver runs; the designer checks it against what it loaded
+    std::atomic<int> installedKernelLength {0};
+    int loadedKernelLength = 0, announcedKernelLength = 0; // designer only
+    
+    // Taken in prepare(), and declared before the convolvers so that it outlives them
+    std::optional<juce::SharedResourcePointer<juce::dsp::ConvolutionMessageQueue>> messageQueue;
+    std::vector<std::unique_ptr<juce::dsp::Convolution>> convolvers; // one per channel pair
+};
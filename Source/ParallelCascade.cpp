@@ -0,0 +1,225 @@
+/*
+  ==============================================================================
+
+    The peak filter cascade rewritten as a parallel sum of second-order
+    sections, so that the sections can be evaluated side by side in SIMD lanes.
+
+  ==============================================================================
+*/
+
+#include "ParallelCascade.h"
+
+namespace
+{
+    // How far below the output the error from rounding the parallel terms to the sample type may reach (-80 dB)
+    constexpr double maxRelativeRoundingError = 1.0e-4;
+}
+
+template <typename SampleType>
+void ParallelCascade<SampleType>::prepare(int newNumChannels, int newNumSections)
+{
+    numChannels = newNumChannels;
+    numSections = newNumSections;
+    numGroups = (numSections + lanesPerGroup - 1) / lanesPerGroup;
+    
+    coefficients.resize((size_t) numGroups, { Vec::expand(0), Vec::expand(0), Vec::expand(0), Vec::expand(0) });
+    states.resize((size_t) (numChannels * numGroups));
+    sections.resize((size_t) numSections);
+    parallelCoefficients.resize((size_t) (2 * numSections));
+    
+    reset();
+}
+
+template <typename SampleType>
+void ParallelCascade<SampleType>::reset()
+{
+    for (auto& state : states)
+        state = { Vec::expand(0), Vec::expand(0) };
+}
+
+template <typename SampleType>
+std::complex<double> ParallelCascade<SampleType>::evaluate(double c0, double c1, double c2, std::complex<double> w) noexcept
+{
+    return c0 + w * (c1 + w * c2);
+}
+
+template <typename SampleType>
+bool ParallelCascade<SampleType>::setCoefficients(const std::array<double, 6>* sectionCoefficients, int numSectionsToUse) noexcept
+{
+    jassert(numSectionsToUse <= numSections);
+    
+    using Complex = std::complex<double>;
+    
+    double productOfB0 = 1.0;
+    
+    for (int k = 0; k < numSectionsToUse; ++k) {
+        auto const& c = sectionCoefficients[k];
+        auto& section = sections[(size_t) k];
+        auto const a0Inv = 1.0 / c[3];
+        
+        section = { c[0] * a0Inv, c[1] * a0Inv, c[2] * a0Inv, c[4] * a0Inv, c[5] * a0Inv, {}, c[0] == c[3] && c[1] == c[4] && c[2] == c[5] };
+        
+        // Poles are the roots of z^2 + a1 z + a2
+        auto const root = std::sqrt(Complex(section.a1 * section.a1 - 4.0 * section.a2));
+        section.poles[0] = (-section.a1 + root) * 0.5;
+        section.poles[1] = (-section.a1 - root) * 0.5;
+        
+        // A double pole (real poles with Q at exactly 0.5) has no simple partial fraction expansion
+        if (! section.isIdentity && std::abs(section.poles[0] - section.poles[1]) < 1.0e-9)
+            return false;
+        
+        productOfB0 *= section.b0;
+    }
+    
+    double sumOfResidues = 0.0;
+    
+    for (int k = 0; k < numSectionsToUse; ++k) {
+        auto const& section = sections[(size_t) k];
+        
+        if (section.isIdentity) {
+            parallelCoefficients[(size_t) (2 * k)] = 0.0;
+            parallelCoefficients[(size_t) (2 * k + 1)] = 0.0;
+            continue;
+        }
+        
+        Complex residues[2];
+        
+        for (int i = 0; i < 2; ++i) {
+            auto const pole = section.poles[i];
+            auto const otherPole = section.poles[1 - i];
+            auto const w = 1.0 / pole;
+            
+            // Residue of H(w) at 1/pole: the whole numerator over every other first-order denominator factor
+            Complex numerator = 1.0, denominator = 1.0 - otherPole * w;
+            
+            for (int j = 0; j < numSectionsToUse; ++j) {
+                auto const& other = sections[(size_t) j];
+                
+                if (other.isIdentity)
+                    continue;
+                
+                numerator *= evaluate(other.b0, other.b1, other.b2, w);
+                
+                if (j != k)
+                    denominator *= evaluate(1.0, other.a1, other.a2, w);
+            }
+            
+            residues[i] = numerator / denominator;
+        }
+        
+        // r0 / (1 - p0 w) + r1 / (1 - p1 w), over the section's own (real) denominator
+        auto const c0 = (residues[0] + residues[1]).real();
+        auto const c1 = -(residues[0] * section.poles[1] + residues[1] * section.poles[0]).real();
+        
+        if (! std::isfinite(c0) || ! std::isfinite(c1))
+            return false;
+        
+        parallelCoefficients[(size_t) (2 * k)] = c0;
+        parallelCoefficients[(size_t) (2 * k + 1)] = c1;
+        sumOfResidues += c0;
+    }
+    
+    // At z^-1 = 0 the cascade is the product of the b0s, which fixes the direct term
+    auto const directTerm = productOfB0 - sumOfResidues;
+    
+    // Both forms must agree on the unit circle, and their terms mustn't cancel out so far that rounding them
+    // to SampleType swamps the result. Checked at a spread of frequencies and at each band's, where its term peaks.
+    auto const maxCancellation = maxRelativeRoundingError / (double) std::numeric_limits<SampleType>::epsilon();
+    
+    auto isWellConditionedAt = [&](double omega) {
+        auto const w = std::polar(1.0, -omega);
+        Complex cascadeResponse = 1.0, parallelResponse = directTerm;
+        double sumOfMagnitudes = std::abs(directTerm);
+        
+        for (int k = 0; k < numSectionsToUse; ++k) {
+            auto const& s = sections[(size_t) k];
+            auto const denominator = evaluate(1.0, s.a1, s.a2, w);
+            
+            cascadeResponse *= evaluate(s.b0, s.b1, s.b2, w) / denominator;
+            
+            if (! s.isIdentity) {
+                auto const term = evaluate(parallelCoefficients[(size_t) (2 * k)], parallelCoefficients[(size_t) (2 * k + 1)], 0.0, w) / denominator;
+                parallelResponse += term;
+                sumOfMagnitudes += std::abs(term);
+            }
+        }
+        
+        auto const magnitude = std::abs(cascadeResponse);
+        
+        return std::abs(cascadeResponse - parallelResponse) <= 1.0e-6 * magnitude
+            && sumOfMagnitudes <= maxCancellation * magnitude;
+    };
+    
+    for (auto omega : { 0.001, 0.01, 0.1, 0.5, 1.0, 2.0, 3.0 })
+        if (! isWellConditionedAt(omega))
+            return false;
+    
+    for (int k = 0; k < numSectionsToUse; ++k)
+        if (! sections[(size_t) k].isIdentity && ! isWellConditionedAt(std::abs(std::arg(sections[(size_t) k].poles[0]))))
+            return false;
+    
+    alignas(Vec) SampleType c0[lanesPerGroup], c1[lanesPerGroup], negA1[lanesPerGroup], negA2[lanesPerGroup];
+    
+    for (int group = 0; group < numGroups; ++group) {
+        for (int lane = 0; lane < lanesPerGroup; ++lane) {
+            auto const k = group * lanesPerGroup + lane;
+            bool const used = k < numSectionsToUse && ! sections[(size_t) k].isIdentity;
+            
+            c0[lane]    = used ? (SampleType) parallelCoefficients[(size_t) (2 * k)] : SampleType();
+            c1[lane]    = used ? (SampleType) parallelCoefficients[(size_t) (2 * k + 1)] : SampleType();
+            negA1[lane] = used ? (SampleType) -sections[(size_t) k].a1 : SampleType();
+            negA2[lane] = used ? (SampleType) -sections[(size_t) k].a2 : SampleType();
+        }
+        
+        coefficients[(size_t) group] = { Vec::fromRawArray(c0), Vec::fromRawArray(c1), Vec::fromRawArray(negA1), Vec::fromRawArray(negA2) };
+    }
+    
+    direct = (SampleType) directTerm;
+    
+    return true;
+}
+
+template <typename SampleType>
+void ParallelCascade<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block) noexcept
+{
+    auto const channelsToProcess = getNumChannels(block);
+    
+    for (int channel = 0; channel < channelsToProcess; ++channel)
+        processChannel(block, channel);
+}
+
+template <typename SampleType>
+int ParallelCascade<SampleType>::getNumChannels(const juce::dsp::AudioBlock<SampleType>& block) const noexcept
+{
+    return juce::jmin((int) block.getNumChannels(), numChannels);
+}
+
+template <typename SampleType>
+void ParallelCascade<SampleType>::processChannel(const juce::dsp::AudioBlock<SampleType>& block, int channel) noexcept
+{
+    auto const numSamples = (int) block.getNumSamples();
+    auto const* groupCoefficients = coefficients.data();
+    auto* data = block.getChannelPointer((size_t) channel);
+    auto* state = states.data() + channel * numGroups;
+    
+    for (int i = 0; i < numSamples; ++i) {
+        auto const input = data[i];
+        auto const x = Vec::expand(input);
+        auto sum = Vec::expand(0);
+        
+        for (int group = 0; group < numGroups; ++group) {
+            auto const& c = groupCoefficients[group];
+            auto& s = state[group];
+            
+            auto y = c.c0 * x + s.s1;
+            s.s1 = c.c1 * x + c.negA1 * y + s.s2;
+            s.s2 = c.negA2 * y;
+            sum += y;
+        }
+        
+        data[i] = direct * input + sum.sum();
+    }
+}
+
+template class ParallelCascade<float>;
+template class ParallelCascade<double>;
@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    The peak filter cascade rewritten as a parallel sum of second-order
+    sections, so that the sections can be evaluated side by side in SIMD lanes.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    A serial cascade is one long dependency chain per sample, so a mono signal
+    can only ever use one SIMD lane. Expanding the cascade's transfer function
+    into partial fractions gives
+    
+        H(z) = d + sum_k (c0_k + c1_k z^-1) / (1 + a1_k z^-1 + a2_k z^-2)
+    
+    where every term only depends on the input sample. The terms are independent,
+    so four of them (one per juce::dsp::SIMDRegister lane) run at once, and the
+    lane outputs are summed.
+    
+    Section k keeps the poles of band k and always lives in the same lane, so the
+    state stays meaningful as gains change. Flat bands cancel out of H(z) and just
+    get zero coefficients. The expansion is done in double precision whenever the
+    band coefficients change; it needs the poles of different bands to be distinct,
+    which holds for any set of fixed, distinct band frequencies.
+    
+    Closely spaced poles make for large terms that mostly cancel, and in single
+    precision that cancellation can eat the result. So every new expansion is
+    checked against the cascade's response, and the sum of its terms' magnitudes
+    against the response itself, before it's used.
+    
+    Like SIMDCascade it's templated on the sample type. The expansion is always
+    done in double; only the resulting coefficients are stored as SampleType.
+*/
+template <typename SampleType>
+class ParallelCascade
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    
+    void prepare(int numChannels, int numSections);
+    void reset();
+    
+    /** Recomputes the parallel form from the cascade's sections, given in the
+        ArrayCoefficients layout (b0, b1, b2, a0, a1, a2). Returns false, leaving
+        the previous realisation in place, if the expansion isn't well conditioned:
+        a double pole, a response that doesn't match the cascade's, or terms that
+        cancel by more than SampleType's precision leaves room for.
+    */
+    bool setCoefficients(const std::array<double, 6>* sectionCoefficients, int numSectionsToUse) noexcept;
+    
+    void process(const juce::dsp::AudioBlock<SampleType>& block) noexcept;
+    
+    // Channels are independent, so they can be processed one at a time from different threads
+    int getNumChannels(const juce::dsp::AudioBlock<SampleType>& block) const noexcept;
+    void processChannel(const juce::dsp::AudioBlock<SampleType>& block, int channel) noexcept;
+    
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+    
+private:
+    struct GroupCoefficients
+    {
+        Vec c0, c1, negA1, negA2;
+    };
+    
+    struct GroupState
+    {
+        Vec s1, s2;
+    };
+    
+    struct Section
+    {
+        double b0, b1, b2, a1, a2;
+        std::complex<double> poles[2];
+        bool isIdentity;
+    };
+    
+    static std::complex<double> evaluate(double c0, double c1, double c2, std::complex<double> w) noexcept;
+    
+    int numChannels = 0, numSections = 0, numGroups = 0;
+    SampleType direct = 1;
+    
+    std::vector<GroupCoefficients> coefficients;
+    std::vector<GroupState> states; // numChannels * numGroups, channel-major
+    
+    std::vector<Section> sections; // scratch for the expansion, sized in prepare()
+    std::vector<double> parallelCoefficients; // c0, c1 per section
+};
@@ -0,0 +1,161 @@
+/*
+  ==============================================================================
+
+    Lookup table of peak filter coefficients for every gain step of every band.
+
+  ==============================================================================
+*/
+
+#include "PeakCoefficientTable.h"
+
+namespace
+{
+    // Weak, so a table lives exactly as long as somebody uses it; dead entries are pruned on the next lookup
+    struct SharedTables
+    {
+        juce::CriticalSection lock;
+        std::vector<std::weak_ptr<const PeakCoefficientTable>> tables;
+    };
+    
+    SharedTables& getSharedTables()
+    {
+        static SharedTables sharedTables;
+        return sharedTables;
+    }
+}
+
+PeakCoefficientTable::Ptr PeakCoefficientTable::getShared(double sampleRate,
+                                                          const float* bandFreqs,
+                                                          const float* bandQualities,
+                                                          int numBands,
+                                                          const juce::NormalisableRange<float>& gainRange)
+{
+    auto& shared = getSharedTables();
+    const juce::ScopedLock sl(shared.lock);
+    
+    auto& tables = shared.tables;
+    tables.erase(std::remove_if(tables.begin(), tables.end(), [](auto const& table) { return table.expired(); }), tables.end());
+    
+    for (auto const& entry : tables)
+        if (auto table = entry.lock())
+            if (table->matches(sampleRate, bandFreqs, bandQualities, numBands, gainRange))
+                return table;
+    
+    // Built under the lock, so instances preparing at the same time don't each build their own
+    Ptr table(new PeakCoefficientTable(sampleRate, bandFreqs, bandQualities, numBands, gainRange));
+    tables.push_back(table);
+    
+    return table;
+}
+
+PeakCoefficientTable::PeakCoefficientTable(double newSampleRate,
+                                           const float* bandFreqs,
+                                           const float* bandQualities,
+                                           int numBands,
+                                           const juce::NormalisableRange<float>& newGainRange)
+    : sampleRate(newSampleRate),
+      gainRange(newGainRange),
+      freqs(bandFreqs, bandFreqs + numBands),
+      qualities(bandQualities, bandQualities + numBands)
+{
+    jassert(newSampleRate > 0.0);
+    
+    // With no interval the parameter is continuous, so there's nothing to tabulate
+    numSteps = gainRange.interval > 0.0f ? juce::roundToInt((gainRange.end - gainRange.start) / gainRange.interval) + 1 : 0;
+    
+    table.resize((size_t) (numBands * numSteps));
+    
+    for (int band = 0; band < numBands; ++band) {
+        for (int step = 0; step < numSteps; ++step) {
+            auto gain = gainRange.start + (float) step * gainRange.interval;
+            table[(size_t) (band * numSteps + step)] = computeCoefficients(band, gain);
+        }
+    }
+}
+
+bool PeakCoefficientTable::matches(double otherSampleRate,
+                                   const float* bandFreqs,
+                                   const float* bandQualities,
+                                   int numBands,
+                                   const juce::NormalisableRange<float>& otherGainRange) const
+{
+    return otherSampleRate == sampleRate
+        && otherGainRange.start == gainRange.start
+        && otherGainRange.end == gainRange.end
+        && otherGainRange.interval == gainRange.interval
+        && (int) freqs.size() == numBands
+        && std::equal(freqs.begin(), freqs.end(), bandFreqs)
+        && std::equal(qualities.begin(), qualities.end(), bandQualities);
+}
+
+PeakCoefficientTable::CoefficientArray PeakCoefficientTable::getCoefficients(int bandIndex, float gainInDecibels) const
+{
+    auto step = getStepIndex(gainInDecibels);
+    
+    if (step >= 0)
+        return table[(size_t) (bandIndex * numSteps + step)];
+    
+    return computeCoefficients(bandIndex, gainInDecibels);
+}
+
+PeakCoefficientTable::CoefficientArray PeakCoefficientTable::getInterpolatedCoefficients(int bandIndex, float gainInDecibels) const
+{
+    if (numSteps < 2)
+        return computeCoefficients(bandIndex, gainInDecibels);
+    
+    auto position = juce::jlimit(0.0f, (float) (numSteps - 1), (gainInDecibels - gainRange.start) / gainRange.interval);
+    auto lower = juce::jmin((int) position, numSteps - 2);
+    auto fraction = position - (float) lower;
+    
+    auto const& a = table[(size_t) (bandIndex * numSteps + lower)];
+    auto const& b = table[(size_t) (bandIndex * numSteps + lower + 1)];
+    
+    // Exactly on a step gives exactly that step, so a flat band still comes out as an exact identity
+    if (fraction == 0.0f)
+        return a;
+    
+    if (fraction == 1.0f)
+        return b;
+    
+    CoefficientArray result;
+    
+    for (size_t i = 0; i < result.size(); ++i)
+        result[i] = a[i] + (double) fraction * (b[i] - a[i]);
+    
+    return result;
+}
+
+std::array<double, 3> PeakCoefficientTable::getSquaredMagnitudeTerms(double x0, double x1, double x2) noexcept
+{
+    auto const sum = x0 + x1 + x2;
+    return { sum * sum, -4.0 * (x0 * x1 + 4.0 * x0 * x2 + x1 * x2), 16.0 * x0 * x2 };
+}
+
+PeakCoefficientTable::CoefficientArray PeakCoefficientTable::computeCoefficients(int bandIndex, float gainInDecibels) const
+{
+    auto c = juce::dsp::IIR::ArrayCoefficients<double>::makePeakFilter(sampleRate,
+                                                                      freqs[(size_t) bandIndex],
+                                                                      qualities[(size_t) bandIndex],
+                                                                      juce::Decibels::decibelsToGain((double) gainInDecibels));
+    auto a0Inv = 1.0 / c[3];
+    
+    // x * (1 / x) isn't always exactly 1; keep a 0 dB band an exact identity so it can be skipped
+    auto b0 = c[0] == c[3] ? 1.0 : c[0] * a0Inv;
+    
+    return {b0, c[1] * a0Inv, c[2] * a0Inv, 1.0, c[4] * a0Inv, c[5] * a0Inv};
+}
+
+int PeakCoefficientTable::getStepIndex(float gainInDecibels) const
+{
+    if (numSteps == 0)
+        return -1;
+    
+    auto position = (gainInDecibels - gainRange.start) / gainRange.interval;
+    auto step = juce::roundToInt(position);
+    
+    // Anything that isn't sitting on a step (e.g. an unquantised host value) gets computed exactly instead
+    if (step < 0 || step >= numSteps || std::abs(position - (float) step) > 1.0e-3f)
+        return -1;
+    
+    return step;
+}
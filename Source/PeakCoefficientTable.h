@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    Lookup table of peak filter coefficients for every gain step of every band.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    The band gains are quantised by the parameter layout (0.5 dB steps over +-12 dB),
+    and the band frequencies and Qs never change, so every coefficient set the EQ can
+    produce at a given sample rate is known up front. Building a table computes all
+    of them once, after which a gain change is just a lookup.
+
+    If the gain range isn't quantised, or a gain doesn't land on a step, the
+    coefficients are computed on demand instead (which doesn't allocate either).
+
+    Entries are normalised so that a0 is 1, which makes interpolating between two
+    neighbouring steps meaningful; that's what the gain smoothing uses, since a
+    smoothed gain is almost never on a step.
+
+    A table never changes once built, and every user in the process that asks for
+    the same sample rate, bands and gain range gets the same one from getShared().
+    Hundreds of instances in one session then hold one table per sample rate
+    between them, only the first to prepare pays for building it, and it goes away
+    with its last reference. Reading needs no lock: the audio thread reads through
+    the pointer its processor holds, which keeps the table alive.
+*/
+class PeakCoefficientTable
+{
+public:
+    // Same layout as juce::dsp::IIR::ArrayCoefficients: b0, b1, b2, a0, a1, a2 (with a0 always 1 here).
+    // Kept in double so that the double precision path gets full precision coefficients too.
+    using CoefficientArray = std::array<double, 6>;
+    using Ptr = std::shared_ptr<const PeakCoefficientTable>;
+    
+    // Looks the table up, or builds it if nobody holds one for these settings. Takes a lock, so call it
+    // from prepareToPlay or another non-realtime thread, never from the audio thread.
+    static Ptr getShared(double sampleRate,
+                         const float* bandFreqs,
+                         const float* bandQualities,
+                         int numBands,
+                         const juce::NormalisableRange<float>& gainRange);
+    
+    CoefficientArray getCoefficients(int bandIndex, float gainInDecibels) const;
+    
+    // Linear interpolation between the two nearest steps, for gains that are in between them
+    CoefficientArray getInterpolatedCoefficients(int bandIndex, float gainInDecibels) const;
+    
+    // |X(e^jw)|^2 of x0 + x1 z^-1 + x2 z^-2 as a quadratic in phi = sin^2(w/2), lowest power first.
+    // Applied to an entry's numerator and denominator, this is how the response plots evaluate it.
+    static std::array<double, 3> getSquaredMagnitudeTerms(double x0, double x1, double x2) noexcept;
+    
+    double getSampleRate() const { return sampleRate; }
+    
+private:
+    PeakCoefficientTable(double sampleRate,
+                         const float* bandFreqs,
+                         const float* bandQualities,
+                         int numBands,
+                         const juce::NormalisableRange<float>& gainRange);
+    
+    bool matches(double sampleRate,
+                 const float* bandFreqs,
+                 const float* bandQualities,
+                 int numBands,
+                 const juce::NormalisableRange<float>& gainRange) const;
+    
+    CoefficientArray computeCoefficients(int bandIndex, float gainInDecibels) const;
+    int getStepIndex(float gainInDecibels) const;
+    
+    double sampleRate = 0.0;
+    int numSteps = 0;
+    juce::NormalisableRange<float> gainRange {-12.f, 12.f};
+    
+    std::vector<float> freqs, qualities;
+    std::vector<CoefficientArray> table; // numBands * numSteps, band-major
+};
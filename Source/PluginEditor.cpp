@@ -30,52 +30,32 @@ void LookAndFeel::drawLinearSlider(juce::Graphics &g,
                                    juce::Slider &slider)
 {
     using namespace juce;
-
+    
     auto trackWidth = jmin (6.0f, (float) width * 0.25f);
-
+    auto const scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    
+    // Groove and notches
+    g.drawImage(getTrackImage(width, height, scale), Rectangle<int>(x, y, width, height).toFloat());
+    
     Point<float> startPoint ((float) x + (float) width * 0.5f,
                              (float) (height + y));
-
-    Point<float> endPoint (startPoint.x,
-                            (float) y);
-
-    Path backgroundTrack;
-    backgroundTrack.startNewSubPath (startPoint);
-    backgroundTrack.lineTo (endPoint);
-    g.setColour(Colour(66u, 56u, 82u));
-    g.strokePath (backgroundTrack, { trackWidth, PathStrokeType::curved, PathStrokeType::rounded });
-    
-    // Draw notches right and left of slider groove
-    int xOffset = width / 4;
-    int notchIntervalCount = 7;
-    float notchX = slider.getLocalBounds().getCentreX() - (trackWidth / 2) - 1.75;
-    float yInterval = (startPoint.y - endPoint.y) / 8;
-    Rectangle<float> marker = Rectangle<float>(notchX + xOffset, startPoint.y - 0.5, 10, 1);
-    for (int j = 0; j < notchIntervalCount; j++) {
-        marker.setY(marker.getY() - yInterval);
-        g.setColour(j == 3 ? Colour(235u, 141u, 171u) : Colour(179u, 152u, 102u));
-        g.fillRect(marker);
-        marker.setX(notchX - xOffset);
-        g.fillRect(marker);
-        marker.setX(notchX + xOffset);
-    }
     
-    Path valueTrack;
     Point<float> minPoint, maxPoint;
-
+    
     auto kx = ((float) x + (float) width * 0.5f);
     auto ky = sliderPos;
-
+    
     minPoint = startPoint;
     maxPoint = { kx, ky };
-
+    
     int thumbWidthIncrease = 5;
     auto thumbWidth = getSliderThumbRadius (slider) + thumbWidthIncrease;
-
-    valueTrack.startNewSubPath (minPoint);
-    valueTrack.lineTo (maxPoint);
+    
+    // A round-capped line, filled directly rather than building and stroking a path every repaint
+    auto valueTrack = Rectangle<float>::leftTopRightBottom(kx - trackWidth / 2, maxPoint.y - trackWidth / 2,
+                                                           kx + trackWidth / 2, minPoint.y + trackWidth / 2);
     g.setColour (slider.findColour (Slider::trackColourId));
-    g.strokePath (valueTrack, { trackWidth, PathStrokeType::curved, PathStrokeType::rounded });
+    g.fillRoundedRectangle (valueTrack, trackWidth / 2);
     
     // Draw thumb control
     g.setColour (Colour(149u, 127u, 184u));
@@ -83,7 +63,6 @@ void LookAndFeel::drawLinearSlider(juce::Graphics &g,
     g.fillRect(thumb);
     
     // Thumb grip
-    auto bounds = Rectangle<float>(x, y, width, height);
     Rectangle<float> r;
     r.setLeft(thumb.getCentre().getX() - (static_cast<float> (thumbWidth)) / 2);
     r.setRight(thumb.getCentre().getX() + (static_cast<float> (thumbWidth)) / 2);
@@ -106,6 +85,51 @@ void LookAndFeel::drawLinearSlider(juce::Graphics &g,
 //    }
 }
 
+const juce::Image& LookAndFeel::getTrackImage(int width, int height, float scale)
+{
+    using namespace juce;
+    
+    auto& image = trackImages[{ width, height, roundToInt(scale * 100.0f) }];
+    
+    if (image.isValid())
+        return image;
+    
+    image = Image(Image::ARGB, jmax(1, roundToInt((float) width * scale)), jmax(1, roundToInt((float) height * scale)), true);
+    Graphics g(image);
+    g.addTransform(AffineTransform::scale(scale));
+    
+    auto trackWidth = jmin (6.0f, (float) width * 0.25f);
+    
+    Point<float> startPoint ((float) width * 0.5f,
+                             (float) height);
+    
+    Point<float> endPoint (startPoint.x,
+                            0.0f);
+    
+    Path backgroundTrack;
+    backgroundTrack.startNewSubPath (startPoint);
+    backgroundTrack.lineTo (endPoint);
+    g.setColour(Colour(66u, 56u, 82u));
+    g.strokePath (backgroundTrack, { trackWidth, PathStrokeType::curved, PathStrokeType::rounded });
+    
+    // Draw notches right and left of slider groove
+    int xOffset = width / 4;
+    int notchIntervalCount = 7;
+    float notchX = width / 2 - (trackWidth / 2) - 1.75;
+    float yInterval = (startPoint.y - endPoint.y) / 8;
+    Rectangle<float> marker = Rectangle<float>(notchX + xOffset, startPoint.y - 0.5, 10, 1);
+    for (int j = 0; j < notchIntervalCount; j++) {
+        marker.setY(marker.getY() - yInterval);
+        g.setColour(j == 3 ? Colour(235u, 141u, 171u) : Colour(179u, 152u, 102u));
+        g.fillRect(marker);
+        marker.setX(notchX - xOffset);
+        g.fillRect(marker);
+        marker.setX(notchX + xOffset);
+    }
+    
+    return image;
+}
+
 juce::String CustomVerticalSlider::getDisplayString() const
 {
     return juce::String(getValue());
@@ -129,47 +153,157 @@ void CustomVerticalSlider::paint(juce::Graphics &g)
                                       *this);
 }
 
+void CustomVerticalSlider::mouseDown(const juce::MouseEvent& event)
+{
+    if (event.mods.isPopupMenu() && onPopupMenu != nullptr) {
+        onPopupMenu();
+        return;
+    }
+    
+    juce::Slider::mouseDown(event);
+}
+
 juce::Rectangle<int> CustomVerticalSlider::getSliderBounds() const
 {
     return getLocalBounds();
 }
 
+void StatsDisplay::timerCallback()
+{
+    auto const snapshot = stats.getSnapshot();
+    
+    juce::String text = "DSP " + juce::String(100.0 * snapshot.averageLoad, 1) + "%, peak " + juce::String(100.0 * snapshot.peakLoad, 1) + "%";
+    
+    if (snapshot.overruns > 0)
+        text << ", " << juce::String(snapshot.overruns) << " overruns";
+    
+    if (snapshot.allocations > 0 || snapshot.locks > 0)
+        text << ", " << juce::String(snapshot.allocations) << " allocs, " << juce::String(snapshot.locks) << " locks";
+    
+    if (text != summary) {
+        summary = text;
+        repaint();
+    }
+}
+
+void StatsDisplay::paint(juce::Graphics& g)
+{
+    g.setFont(12);
+    g.setColour(juce::Colour(126u, 156u, 216u));
+    g.drawFittedText(summary, getLocalBounds(), juce::Justification::centredRight, 1);
+}
+
+void StatsDisplay::mouseDown(const juce::MouseEvent& event)
+{
+    juce::PopupMenu menu;
+    menu.addItem("Copy stats as text", [this] { juce::SystemClipboard::copyTextToClipboard(stats.getSnapshot().toText()); });
+    menu.addItem("Copy stats as JSON", [this] { juce::SystemClipboard::copyTextToClipboard(stats.getSnapshot().toJSON()); });
+    menu.addSeparator();
+    menu.addItem("Reset stats", [this] { stats.reset(); });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+
+void PresetMenu::paint(juce::Graphics& g)
+{
+    g.setFont(12);
+    g.setColour(juce::Colour(126u, 156u, 216u));
+    g.drawFittedText(processor.getProgramName(processor.getCurrentProgram()), getLocalBounds(), juce::Justification::centredLeft, 1);
+}
+
+void PresetMenu::mouseDown(const juce::MouseEvent& event)
+{
+    juce::PopupMenu recall, store, clear;
+    
+    for (int i = 0; i < processor.getNumPrograms(); ++i) {
+        auto const name = processor.getProgramName(i);
+        auto const isUsed = processor.isPresetUsed(i);
+        
+        recall.addItem(name, isUsed, i == processor.getCurrentProgram(), [this, i]
+        {
+            processor.setCurrentProgram(i);
+            repaint();
+        });
+        
+        store.addItem(name, [this, i] { processor.storePreset(i); });
+        clear.addItem(name, isUsed, false, [this, i] { processor.clearPreset(i); });
+    }
+    
+    juce::PopupMenu menu;
+    menu.addSubMenu("Recall", recall);
+    menu.addSubMenu("Store", store);
+    menu.addSubMenu("Clear", clear);
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+
+void MatchDisplay::setText(const juce::String& newText)
+{
+    if (newText != text) {
+        text = newText;
+        repaint();
+    }
+}
+
+void MatchDisplay::paint(juce::Graphics& g)
+{
+    g.setFont(12);
+    g.setColour(juce::Colour(126u, 156u, 216u));
+    g.drawFittedText(text, getLocalBounds(), juce::Justification::centredLeft, 1);
+}
+
+void MatchDisplay::mouseDown(const juce::MouseEvent&)
+{
+    if (onClick != nullptr)
+        onClick();
+}
+
 //==============================================================================
 GraphicEQAudioProcessorEditor::GraphicEQAudioProcessorEditor (GraphicEQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
-    band20Slider(*audioProcessor.apvts.getParameter(allBandNames[0])),
-    band32Slider(*audioProcessor.apvts.getParameter(allBandNames[1])),
-    band64Slider(*audioProcessor.apvts.getParameter(allBandNames[2])),
-    band125Slider(*audioProcessor.apvts.getParameter(allBandNames[3])),
-    band250Slider(*audioProcessor.apvts.getParameter(allBandNames[4])),
-    band500Slider(*audioProcessor.apvts.getParameter(allBandNames[5])),
-    band1kSlider(*audioProcessor.apvts.getParameter(allBandNames[6])),
-    band2kSlider(*audioProcessor.apvts.getParameter(allBandNames[7])),
-    band4kSlider(*audioProcessor.apvts.getParameter(allBandNames[8])),
-    band8kSlider(*audioProcessor.apvts.getParameter(allBandNames[9])),
-    band16kSlider(*audioProcessor.apvts.getParameter(allBandNames[10])),
-    band20kSlider(*audioProcessor.apvts.getParameter(allBandNames[11])),
-    band20SliderAttachment(audioProcessor.apvts, allBandNames[0], band20Slider),
-    band32SliderAttachment(audioProcessor.apvts, allBandNames[1], band32Slider),
-    band64SliderAttachment(audioProcessor.apvts, allBandNames[2], band64Slider),
-    band125SliderAttachment(audioProcessor.apvts, allBandNames[3], band125Slider),
-    band250SliderAttachment(audioProcessor.apvts, allBandNames[4], band250Slider),
-    band500SliderAttachment(audioProcessor.apvts, allBandNames[5], band500Slider),
-    band1kSliderAttachment(audioProcessor.apvts, allBandNames[6], band1kSlider),
-    band2kSliderAttachment(audioProcessor.apvts, allBandNames[7], band2kSlider),
-    band4kSliderAttachment(audioProcessor.apvts, allBandNames[8], band4kSlider),
-    band8kSliderAttachment(audioProcessor.apvts, allBandNames[9], band8kSlider),
-    band16kSliderAttachment(audioProcessor.apvts, allBandNames[10], band16kSlider),
-    band20kSliderAttachment(audioProcessor.apvts, allBandNames[11], band20kSlider)
+      responseCurve (p.apvts.getParameter(Bands::names[0])->getNormalisableRange()),
+      spectrumAnalyser (p.getAnalyserTap()),
+      targetMatcher (p.apvts.getParameter(Bands::names[0])->getNormalisableRange()),
+      statsDisplay (p.getProcessingStats()),
+      presetMenu (p)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     
+    for (int i = 0; i < numBands; ++i) {
+        auto& parameter = *audioProcessor.apvts.getParameter(Bands::names[i]);
+        sliders[i] = std::make_unique<CustomVerticalSlider>(parameter);
+        sliderAttachments[i] = std::make_unique<DeferredSliderAttachment>(parameter, *sliders[i]);
+        sliders[i]->onPopupMenu = [this, i] { showDynamicsMenu(i); };
+        sliders[i]->onDragStart = [this] { cancelMatch(); };
+        sliders[i]->onValueChange = [this] { cancelMatch(); };
+    }
+    
+    matchDisplay.onClick = [this] { showMatchMenu(); };
+    
+    vBlankAttachment = juce::VBlankAttachment(this, [this] {
+        for (auto& attachment : sliderAttachments) {
+            attachment->applyPendingValue();
+        }
+        
+        updateResponseCurve();
+        updateSpectra();
+        updateMatch();
+    });
+    
     for (auto* slider : getSliders()) {
         addAndMakeVisible(slider);
     }
     
-    setSize (800, 300);
+    addAndMakeVisible(statsDisplay);
+    addAndMakeVisible(presetMenu);
+    addAndMakeVisible(matchDisplay);
+    
+    // The cached background covers every pixel, so nothing behind the editor needs painting
+    setOpaque(true);
+    
+    // Wide layouts get more room, so the sliders and their labels stay legible
+    setSize (juce::jmax(800, 48 * numBands), 300);
 }
 
 GraphicEQAudioProcessorEditor::~GraphicEQAudioProcessorEditor()
@@ -178,6 +312,38 @@ GraphicEQAudioProcessorEditor::~GraphicEQAudioProcessorEditor()
 
 //==============================================================================
 void GraphicEQAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // Automation repaints land here too, clipped to the slider that moved: that's one blit of the cache
+    auto const scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    auto const width = juce::roundToInt((float) getWidth() * scale);
+    auto const height = juce::roundToInt((float) getHeight() * scale);
+    
+    if (scale != backgroundScale || backgroundImage.getWidth() != width || backgroundImage.getHeight() != height) {
+        backgroundImage = juce::Image(juce::Image::RGB, juce::jmax(1, width), juce::jmax(1, height), false);
+        backgroundScale = scale;
+        
+        juce::Graphics imageGraphics(backgroundImage);
+        imageGraphics.addTransform(juce::AffineTransform::scale(scale));
+        drawBackground(imageGraphics);
+    }
+    
+    g.drawImage(backgroundImage, getLocalBounds().toFloat());
+    
+    // Behind the sliders, and already stroked by the threads that computed them
+    if (currentSpectra != nullptr) {
+        g.setColour(juce::Colour(149u, 127u, 184u).withAlpha(0.35f));
+        g.fillPath(currentSpectra->preEQ);
+        g.setColour(juce::Colour(230u, 195u, 132u).withAlpha(0.6f));
+        g.fillPath(currentSpectra->postEQ);
+    }
+    
+    if (currentCurve != nullptr) {
+        g.setColour(juce::Colour(127u, 180u, 202u).withAlpha(0.8f));
+        g.fillPath(currentCurve->outline);
+    }
+}
+
+void GraphicEQAudioProcessorEditor::drawBackground(juce::Graphics& g)
 {
     using namespace juce;
     // (Our component is opaque, so we must completely fill the background with a solid colour)
@@ -194,7 +360,7 @@ void GraphicEQAudioProcessorEditor::paint (juce::Graphics& g)
     
     yMargin = bounds.getHeight() * yMarginMultiplier;
     xMargin = bounds.getWidth() * xMarginMultiplier;
-
+    
     auto gainTextMargin = bounds.removeFromLeft(xMargin);
     bounds.removeFromRight(xMargin);
     auto parameterTextMargin = bounds.removeFromTop(yMargin);
@@ -203,7 +369,7 @@ void GraphicEQAudioProcessorEditor::paint (juce::Graphics& g)
     // Draw title and credit
     g.setFont(16);
     g.setColour(Colour(210u, 126u, 153u));
-    juce::String titleText = "12 Band Graphic EQ - by Hakurosalix";
+    juce::String titleText = juce::String(Bands::title) + " - by Hakurosalix";
     g.drawFittedText(titleText, titleTextMargin.toNearestInt(), juce::Justification::centred, 1);
     
     // Draw gain labels
@@ -220,13 +386,13 @@ void GraphicEQAudioProcessorEditor::paint (juce::Graphics& g)
     g.drawFittedText(gainTextBottom, gainTextMargin.toNearestInt(), juce::Justification::centredBottom, 1);
     
     
-    sliderSpace = bounds.getWidth() / 12;
+    sliderSpace = bounds.getWidth() / numBands;
     
     // Draw band frequency labels
-    for (int i = 0; i < allBandNames.size(); i++) {
+    for (int i = 0; i < numBands; i++) {
         auto sliderTextBounds = parameterTextMargin.removeFromLeft(sliderSpace);
         g.setFont(14);
-        auto text = bandLabels[i];
+        auto text = Bands::labels[i];
         g.setColour(Colour(230u, 195u, 132u));
         g.drawFittedText(text, sliderTextBounds.toNearestInt(), juce::Justification::centred, 1);
     }
@@ -242,42 +408,285 @@ void GraphicEQAudioProcessorEditor::resized()
     // This is generally where you'll want to lay out the positions of any
     // subcomponents in your editor..
     
-    // 12 sliders, evenly spaced...
+    // One slider per band, evenly spaced...
     auto bounds = getLocalBounds();
     
     yMargin = bounds.getHeight() * yMarginMultiplier;
     xMargin = bounds.getWidth() * xMarginMultiplier;
     
     bounds.removeFromTop(yMargin);
-    bounds.removeFromBottom(yMargin);
+    
+    // Bottom corners, clear of the centred title
+    auto statsBounds = bounds.removeFromBottom(yMargin);
+    statsDisplay.setBounds(statsBounds.removeFromRight(bounds.getWidth() / 4).reduced(8, 0));
+    auto menuBounds = statsBounds.removeFromLeft(bounds.getWidth() / 4).reduced(8, 0);
+    presetMenu.setBounds(menuBounds.removeFromLeft(menuBounds.getWidth() / 2));
+    matchDisplay.setBounds(menuBounds);
+    
     bounds.removeFromLeft(xMargin);
     bounds.removeFromRight(xMargin);
     
-    sliderSpace = bounds.getWidth() / 12;
+    sliderSpace = bounds.getWidth() / numBands;
+    curveArea = bounds.withWidth(sliderSpace * numBands).toFloat();
     
     for (CustomVerticalSlider* slider : getSliders()) {
         auto sliderBounds = bounds.removeFromLeft(sliderSpace);
         slider->setBounds(sliderBounds);
     }
+
+}
+
+void GraphicEQAudioProcessorEditor::updateResponseCurve()
+{
+    // The sliders hold the latest gains by now, whether they came from the mouse or from automation
+    std::array<float, numBands> gains;
+    
+    for (int i = 0; i < numBands; ++i) {
+        gains[i] = (float) sliders[i]->getValue();
+    }
+    
+    // Until the host prepares the processor there's no sample rate, but the curve looks much the same at any
+    auto const sampleRate = audioProcessor.getSampleRate();
+    responseCurve.update(sampleRate > 0.0 ? sampleRate : 44100.0, gains, curveArea);
+    
+    // Only the strip the old and new curves cover needs repainting
+    if (auto* curve = responseCurve.pickUpLatest()) {
+        auto const bounds = curve->outline.getBounds();
+        repaint(bounds.getUnion(currentCurveBounds).getSmallestIntegerContainer().expanded(1, 1));
+        
+        currentCurve = curve;
+        currentCurveBounds = bounds;
+    }
+}
+
+void GraphicEQAudioProcessorEditor::updateSpectra()
+{
+    auto const sampleRate = audioProcessor.getSampleRate();
+    
+    if (sampleRate > 0.0)
+        spectrumAnalyser.update(sampleRate, curveArea);
+    
+    // Last frame's analysis, if it's done; the spectra move everywhere, so the whole area is repainted
+    if (auto* spectra = spectrumAnalyser.pickUpLatest()) {
+        currentSpectra = spectra;
+        repaint(curveArea.getSmallestIntegerContainer().expanded(2, 2));
+    }
+}
+
+//==============================================================================
+DeferredSliderAttachment::DeferredSliderAttachment(juce::RangedAudioParameter& parameter, juce::Slider& s)
+    : slider(s),
+      attachment(parameter, [this] (float newValue) {
+          pendingValue = newValue;
+          hasPendingValue = true;
+      })
+{
+    // The same range, text conversion and double-click reset APVTS::SliderAttachment sets up
+    auto const range = parameter.getNormalisableRange();
+    slider.setNormalisableRange({ range.start, range.end, range.interval, range.skew });
+    slider.valueFromTextFunction = [&parameter] (const juce::String& text) { return (double) parameter.convertFrom0to1(parameter.getValueForText(text)); };
+    slider.textFromValueFunction = [&parameter] (double value) { return parameter.getText(parameter.convertTo0to1((float) value), 0); };
+    slider.setDoubleClickReturnValue(true, parameter.convertFrom0to1(parameter.getDefaultValue()));
     
+    attachment.sendInitialUpdate();
+    applyPendingValue();
+    slider.addListener(this);
 }
 
-std::vector<CustomVerticalSlider*> GraphicEQAudioProcessorEditor::getSliders()
+DeferredSliderAttachment::~DeferredSliderAttachment()
+{
+    slider.removeListener(this);
+}
+
+void DeferredSliderAttachment::applyPendingValue()
+{
+    if (! hasPendingValue)
+        return;
+    
+    // No notification, so this doesn't echo back to the parameter
+    hasPendingValue = false;
+    slider.setValue(pendingValue, juce::dontSendNotification);
+}
+
+void DeferredSliderAttachment::sliderValueChanged(juce::Slider*)
+{
+    attachment.setValueAsPartOfGesture((float) slider.getValue());
+    
+    // The parameter reports the value just set straight back; the slider already shows it
+    hasPendingValue = false;
+}
+
+void DeferredSliderAttachment::sliderDragStarted(juce::Slider*)
+{
+    attachment.beginGesture();
+}
+
+void DeferredSliderAttachment::sliderDragEnded(juce::Slider*)
 {
-    return
+    attachment.endGesture();
+}
+
+void GraphicEQAudioProcessorEditor::showDynamicsMenu(int bandIndex)
+{
+    auto& apvts = audioProcessor.apvts;
+    auto* dynamic = apvts.getParameter(GraphicEQAudioProcessor::getDynamicParameterID(bandIndex));
+    auto* threshold = apvts.getParameter(GraphicEQAudioProcessor::getThresholdParameterID(bandIndex));
+    auto* attack = apvts.getParameter(GraphicEQAudioProcessor::attackParameterID);
+    auto* release = apvts.getParameter(GraphicEQAudioProcessor::releaseParameterID);
+    
+    // One gesture per choice, so hosts record it as a single automation point
+    auto set = [](juce::RangedAudioParameter* parameter, float value)
+    {
+        parameter->beginChangeGesture();
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        parameter->endChangeGesture();
+    };
+    
+    // A submenu of values with the closest one to the current value ticked
+    auto makeChoices = [&](juce::RangedAudioParameter* parameter, std::initializer_list<float> values, const juce::String& unit)
     {
-        &band20Slider,
-        &band32Slider,
-        &band64Slider,
-        &band125Slider,
-        &band250Slider,
-        &band500Slider,
-        &band1kSlider,
-        &band2kSlider,
-        &band4kSlider,
-        &band8kSlider,
-        &band16kSlider,
-        &band20kSlider
+        juce::PopupMenu choices;
+        auto const current = parameter->convertFrom0to1(parameter->getValue());
+        
+        for (auto const value : values) {
+            choices.addItem(juce::String(value) + " " + unit, true, std::abs(current - value) < 0.01f, [set, parameter, value]
+            {
+                set(parameter, value);
+            });
+        }
+        
+        return choices;
     };
+    
+    auto const isDynamic = dynamic->getValue() >= 0.5f;
+    
+    juce::PopupMenu menu;
+    menu.addSectionHeader(juce::String(Bands::labels[bandIndex]) + " Hz");
+    menu.addItem("Dynamic", true, isDynamic, [set, dynamic, isDynamic] { set(dynamic, isDynamic ? 0.0f : 1.0f); });
+    menu.addSubMenu("Threshold", makeChoices(threshold, {-48.0f, -42.0f, -36.0f, -30.0f, -24.0f, -18.0f, -12.0f, -6.0f}, "dB"));
+    menu.addSeparator();
+    menu.addSubMenu("Attack (all bands)", makeChoices(attack, {1.0f, 2.0f, 5.0f, 10.0f, 20.0f, 50.0f}, "ms"));
+    menu.addSubMenu("Release (all bands)", makeChoices(release, {25.0f, 50.0f, 100.0f, 250.0f, 500.0f, 1000.0f}, "ms"));
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(sliders[bandIndex].get()));
+}
+
+void GraphicEQAudioProcessorEditor::showMatchMenu()
+{
+    juce::PopupMenu menu;
+    menu.addItem("Match target curve (CSV)...", [this] { loadTargetCurve(); });
+    menu.addItem("Match input spectrum", currentSpectra != nullptr, false, [this] { matchInputSpectrum(false); });
+    menu.addItem("Flatten input spectrum", currentSpectra != nullptr, false, [this] { matchInputSpectrum(true); });
+    menu.addSeparator();
+    menu.addItem("Cancel", pendingMatch != 0, false, [this] { cancelMatch(); });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&matchDisplay));
+}
+
+void GraphicEQAudioProcessorEditor::loadTargetCurve()
+{
+    // Owned here, so closing the editor while it's open drops the callback too
+    fileChooser = std::make_unique<juce::FileChooser>("Target curve: frequency, dB per line", juce::File(), "*.csv;*.txt");
+    
+    auto const flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
+    
+    fileChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+    {
+        auto const file = chooser.getResult();
+        
+        if (file == juce::File())
+            return;
+        
+        TargetMatcher::Target target;
+        
+        if (TargetMatcher::parseCSV(file.loadFileAsString(), target))
+            startMatch(target);
+        else
+            matchDisplay.setText("No curve in " + file.getFileName());
+    });
+}
+
+void GraphicEQAudioProcessorEditor::matchInputSpectrum(bool flatten)
+{
+    if (currentSpectra == nullptr)
+        return;
+    
+    // Only columns with signal in them count, relative to their average level
+    std::vector<juce::Point<double>> curve;
+    double sum = 0.0;
+    
+    for (int column = 0; column < SpectrumAnalyser::numColumns; ++column) {
+        auto const level = currentSpectra->preEQLevels[(size_t) column];
+        
+        if (level > SpectrumAnalyser::floorDecibels + 1.0f) {
+            curve.push_back({ SpectrumAnalyser::getColumnFrequency(column), (double) level });
+            sum += level;
+        }
+    }
+    
+    if (curve.empty()) {
+        matchDisplay.setText("No input to match");
+        return;
+    }
+    
+    auto const mean = sum / (double) curve.size();
+    
+    for (auto& point : curve)
+        point.y = flatten ? mean - point.y : point.y - mean;
+    
+    TargetMatcher::Target target;
+    
+    if (TargetMatcher::makeTarget(std::move(curve), target))
+        startMatch(target);
+}
+
+void GraphicEQAudioProcessorEditor::startMatch(const TargetMatcher::Target& target)
+{
+    auto const sampleRate = audioProcessor.getSampleRate();
+    pendingMatch = targetMatcher.match(sampleRate > 0.0 ? sampleRate : 44100.0, target);
+    matchDisplay.setText("Matching...");
 }
 
+void GraphicEQAudioProcessorEditor::cancelMatch()
+{
+    if (pendingMatch == 0)
+        return;
+    
+    targetMatcher.cancel();
+    pendingMatch = 0;
+    matchDisplay.setText("Auto EQ cancelled");
+}
+
+void GraphicEQAudioProcessorEditor::updateMatch()
+{
+    if (pendingMatch == 0)
+        return;
+    
+    auto const* result = targetMatcher.pickUpLatest();
+    
+    if (result == nullptr || result->request != pendingMatch)
+        return;
+    
+    pendingMatch = 0;
+    
+    // One gesture per band, like moving each slider by hand; the sliders follow on the next frame
+    for (int i = 0; i < numBands; ++i) {
+        auto* parameter = audioProcessor.apvts.getParameter(Bands::names[i]);
+        parameter->beginChangeGesture();
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(result->bandGains[(size_t) i]));
+        parameter->endChangeGesture();
+    }
+    
+    matchDisplay.setText("Matched, " + juce::String(result->rmsErrorDecibels, 1) + " dB rms off");
+}
+
+std::vector<CustomVerticalSlider*> GraphicEQAudioProcessorEditor::getSliders()
+{
+    std::vector<CustomVerticalSlider*> result;
+    
+    for (auto& slider : sliders) {
+        result.push_back(slider.get());
+    }
+    
+    return result;
+}
@@ -10,7 +10,11 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "ResponseCurve.h"
+#include "SpectrumAnalyser.h"
+#include "TargetMatcher.h"
 
+// One instance is shared by every slider of every open editor, see CustomVerticalSlider
 struct LookAndFeel : juce::LookAndFeel_V4
 {
     void drawLinearSlider (juce::Graphics&,
@@ -20,6 +24,12 @@ struct LookAndFeel : juce::LookAndFeel_V4
                                 float maxSliderPos,
                                 juce::Slider::SliderStyle,
                                 juce::Slider&) override;
+
+private:
+    // The groove and its notches never move, so they're drawn once per slider size and display scale
+    const juce::Image& getTrackImage(int width, int height, float scale);
+    
+    std::map<std::tuple<int, int, int>, juce::Image> trackImages;
 };
 
 struct CustomVerticalSlider : juce::Slider
@@ -30,7 +40,7 @@ public:
                                         juce::Slider::TextEntryBoxPosition::NoTextBox),
     param(&rap)
     {
-        setLookAndFeel(&lnf);
+        setLookAndFeel(lnf);
     }
     
     ~CustomVerticalSlider()
@@ -39,15 +49,88 @@ public:
     }
     
     void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
     juce::Rectangle<int> getSliderBounds() const;
     int getTextHeight() const {return 14;}
     juce::String getDisplayString() const;
     
+    // Right click, instead of dragging
+    std::function<void()> onPopupMenu;
+
 private:
-    LookAndFeel lnf;
+    juce::SharedResourcePointer<LookAndFeel> lnf;
     juce::RangedAudioParameter* param;
     juce::String const displayString {"Hz"};
+
+};
+
+// Connects a slider to its parameter like APVTS::SliderAttachment, except that parameter changes
+// are held until applyPendingValue(), which the editor calls once per display refresh. However
+// fast the host automates, each slider then moves and repaints at most once a frame.
+struct DeferredSliderAttachment : private juce::Slider::Listener
+{
+public:
+    DeferredSliderAttachment(juce::RangedAudioParameter& parameter, juce::Slider& slider);
+    ~DeferredSliderAttachment() override;
+    
+    void applyPendingValue();
+
+private:
+    void sliderValueChanged(juce::Slider*) override;
+    void sliderDragStarted(juce::Slider*) override;
+    void sliderDragEnded(juce::Slider*) override;
+    
+    juce::Slider& slider;
+    juce::ParameterAttachment attachment;
+    double pendingValue = 0.0;
+    bool hasPendingValue = false;
+};
+
+// A one line summary of the processor's audio thread stats, refreshed a few times a second.
+// Clicking it offers the full snapshot as text or JSON, and a reset.
+struct StatsDisplay : juce::Component, juce::Timer
+{
+public:
+    StatsDisplay(ProcessingStats& processingStats) : stats(processingStats)
+    {
+        startTimerHz(4);
+    }
+    
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+    void timerCallback() override;
+
+private:
+    ProcessingStats& stats;
+    juce::String summary;
+};
+
+// The processor's preset bank. Clicking it offers to recall, store or clear a preset.
+struct PresetMenu : juce::Component
+{
+public:
+    PresetMenu(GraphicEQAudioProcessor& p) : processor(p) {}
     
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+
+private:
+    GraphicEQAudioProcessor& processor;
+};
+
+// The auto EQ's state. Clicking it offers the targets to match, see GraphicEQAudioProcessorEditor::showMatchMenu().
+struct MatchDisplay : juce::Component
+{
+public:
+    void setText(const juce::String& newText);
+    
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+    
+    std::function<void()> onClick;
+
+private:
+    juce::String text {"Auto EQ"};
 };
 
 //==============================================================================
@@ -58,7 +141,7 @@ class GraphicEQAudioProcessorEditor  : public juce::AudioProcessorEditor
 public:
     GraphicEQAudioProcessorEditor (GraphicEQAudioProcessor&);
     ~GraphicEQAudioProcessorEditor() override;
-
+    
     //==============================================================================
     void paint (juce::Graphics&) override;
     void resized() override;
@@ -68,39 +151,54 @@ private:
     // access the processor object that created it.
     GraphicEQAudioProcessor& audioProcessor;
     
-    CustomVerticalSlider band20Slider,
-                            band32Slider,
-                            band64Slider,
-                            band125Slider,
-                            band250Slider,
-                            band500Slider,
-                            band1kSlider,
-                            band2kSlider,
-                            band4kSlider,
-                            band8kSlider,
-                            band16kSlider,
-                            band20kSlider;
-    
-    using Attachment = juce::AudioProcessorValueTreeState::SliderAttachment;
-    
-    Attachment band20SliderAttachment,
-                band32SliderAttachment,
-                band64SliderAttachment,
-                band125SliderAttachment,
-                band250SliderAttachment,
-                band500SliderAttachment,
-                band1kSliderAttachment,
-                band2kSliderAttachment,
-                band4kSliderAttachment,
-                band8kSliderAttachment,
-                band16kSliderAttachment,
-                band20kSliderAttachment;
+    // One slider per band of the compiled-in layout, in band order
+    std::array<std::unique_ptr<CustomVerticalSlider>, numBands> sliders;
+    
+    std::array<std::unique_ptr<DeferredSliderAttachment>, numBands> sliderAttachments;
+    
+    // Evaluated on its own thread; the curve picked up last stays valid until the next pick-up
+    ResponseCurve responseCurve;
+    const ResponseCurve::Curve* currentCurve = nullptr;
+    juce::Rectangle<float> currentCurveBounds, curveArea;
+    
+    void updateResponseCurve();
+    
+    // Runs for as long as the editor is open, and the processor only feeds it meanwhile
+    SpectrumAnalyser spectrumAnalyser;
+    const SpectrumAnalyser::Spectra* currentSpectra = nullptr;
+    
+    void updateSpectra();
+    
+    // Automation only reaches the sliders here, once per frame
+    juce::VBlankAttachment vBlankAttachment;
+    
+    // Fits the sliders to a target curve on its own thread. Moving a slider by hand while it runs
+    // cancels the fit, so a result never overwrites what the user just did.
+    TargetMatcher targetMatcher;
+    int pendingMatch = 0;
+    std::unique_ptr<juce::FileChooser> fileChooser;
+    
+    void showMatchMenu();
+    void loadTargetCurve();
+    void matchInputSpectrum(bool flatten);
+    void startMatch(const TargetMatcher::Target& target);
+    void cancelMatch();
+    void updateMatch();
+    
+    StatsDisplay statsDisplay;
+    PresetMenu presetMenu;
+    MatchDisplay matchDisplay;
+    
+    // The background and labels only change with the size or the display scale
+    juce::Image backgroundImage;
+    float backgroundScale = 0.0f;
+    
+    void drawBackground(juce::Graphics& g);
     
     std::vector<CustomVerticalSlider*> getSliders();
     
-    std::vector<juce::String> const bandLabels {"20", "32", "64", "125",
-                                        "250", "500", "1k", "2k",
-                                        "4k", "8k", "16k", "20k"};
-
+    // The band's dynamic EQ settings, on right clicking its slider
+    void showDynamicsMenu(int bandIndex);
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphicEQAudioProcessorEditor)
 };
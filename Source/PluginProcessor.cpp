@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "AllocationGuard.h"
 
 //==============================================================================
 GraphicEQAudioProcessor::GraphicEQAudioProcessor()
@@ -22,10 +23,24 @@ GraphicEQAudioProcessor::GraphicEQAudioProcessor()
                        )
 #endif
 {
+    for (int i = 0; i < numBands; ++i) {
+        bandGainValues[i] = apvts.getRawParameterValue(Bands::names[i]);
+        bandParameters[i] = apvts.getParameter(Bands::names[i]);
+        bandDynamicValues[i] = apvts.getRawParameterValue(getDynamicParameterID(i));
+        bandThresholdValues[i] = apvts.getRawParameterValue(getThresholdParameterID(i));
+        bandCoefficientArrays[i] = {1.0, 0.0, 0.0, 1.0, 0.0, 0.0};
+    }
+    
+    dynamicAttackValue = apvts.getRawParameterValue(attackParameterID);
+    dynamicReleaseValue = apvts.getRawParameterValue(releaseParameterID);
+    
+    linearPhaseEQ.onLatencyChanged = [this] { triggerAsyncUpdate(); };
 }
 
 GraphicEQAudioProcessor::~GraphicEQAudioProcessor()
 {
+    // The designer calls back into this, so it stops before anything else goes
+    linearPhaseEQ.release();
 }
 
 //==============================================================================
@@ -63,27 +78,32 @@ bool GraphicEQAudioProcessor::isMidiEffect() const
 
 double GraphicEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // Follows the bands as they change, see updateTailLength()
+    return tailLengthSeconds.load();
 }
 
 int GraphicEQAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return PresetBank::numPresets;
 }
 
 int GraphicEQAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
 void GraphicEQAudioProcessor::setCurrentProgram (int index)
 {
+    if (! juce::isPositiveAndBelow(index, PresetBank::numPresets))
+        return;
+    
+    currentProgram = index;
+    recallPreset(index);
 }
 
 const juce::String GraphicEQAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return "Preset " + juce::String(index + 1);
 }
 
 void GraphicEQAudioProcessor::changeProgramName (int index, const juce::String& newName)
@@ -96,24 +116,73 @@ void GraphicEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBl
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     
-    juce::dsp::ProcessSpec spec;
+    auto chainSettings = getChainSettings(apvts);
+    fetchedSettings = chainSettings;
+    anyBandDynamic = std::find(chainSettings.bandDynamic.begin(), chainSettings.bandDynamic.end(), true) != chainSettings.bandDynamic.end();
+    processingStats.prepare(sampleRate);
     
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
+    bandDetector.prepare(sampleRate, Bands::freqs.data(), Bands::qualities.data(), numBands, samplesPerBlock);
+    bandDetector.setTimes(chainSettings.dynamicAttackMs, chainSettings.dynamicReleaseMs);
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    // The only per-channel memory is filter state; it's all allocated here for the current layout
+    // and precision, so processBlock() never has to allocate however many channels the host sends
+    forActiveEngines([&](auto& engines)
+    {
+        engines.cascade.prepare(getTotalNumInputChannels(), numBands);
+        engines.parallelCascade.prepare(getTotalNumInputChannels(), numBands);
+        engines.svfCascade.prepare(sampleRate,
+                                   Bands::freqs.data(),
+                                   Bands::qualities.data(),
+                                   getTotalNumInputChannels(),
+                                   numBands);
+        engines.parallelFormNeedsUpdate = true;
+    });
     
-    auto chainSettings = getChainSettings(apvts);
+    updateWorkerPool();
+    
+    for (auto& smoothedGain : smoothedBandGains) {
+        smoothedGain.reset(sampleRate, smoothingTimeSeconds);
+    }
     
+    samplesUntilSmoothingUpdate = 0;
+    
+    // All bands share the same gain range, so the first one stands in for the rest
+    coefficientTable = PeakCoefficientTable::getShared(sampleRate,
+                                                       Bands::freqs.data(),
+                                                       Bands::qualities.data(),
+                                                       numBands,
+                                                       apvts.getParameter(Bands::names[0])->getNormalisableRange());
+    
+    presetBank.setCoefficientTable(coefficientTable);
+    
+    // Nothing has been detected yet, so dynamic bands start out flat
+    updateTargetGains();
+    chainSettings.bandGains = targetBandGains;
     updatePeakFilters(chainSettings);
+    
+    linearPhaseSpec = { sampleRate, (juce::uint32) samplesPerBlock, (juce::uint32) getTotalNumInputChannels() };
+    linearPhaseIsPrepared = false;
+    
+    // After the bands, so that the first kernel is designed from the current gains
+    if (filterEngine.load() == FilterEngine::linearPhase)
+        prepareLinearPhase(appliedBandGains.data());
+    else
+        linearPhaseEQ.release();
+    
+    updateLatency();
+    updateTailLength();
+    
+    silentSamples = 0;
+    isIdle = false;
 }
 
 void GraphicEQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    
+    // No point keeping worker threads around while nothing plays, prepareToPlay() restarts them
+    workerPool.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -124,30 +193,45 @@ bool GraphicEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel goes through the same bands, so any layout works (surround, ambisonic beds, plain
+    // discrete channels) as long as there is one. The cascade packs however many channels there are
+    // into SIMD lane groups, sized in prepareToPlay().
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
-
+    
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
    #endif
-
+   
     return true;
   #endif
 }
 #endif
 
 void GraphicEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+void GraphicEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+template <typename SampleType>
+void GraphicEQAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
+    ScopedNoAllocation noAllocation;
+    ScopedAllocationCounter allocationCounter;
+    auto const locksBefore = LockCounter::getCountOnThisThread();
+    processingStats.beginBlock();
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
-
+    
     // In case we have more outputs than inputs, this code clears any output
     // channels that didn't contain input data, (because these aren't
     // guaranteed to be empty - they may contain garbage).
@@ -157,31 +241,297 @@ void GraphicEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    auto chainSettings = getChainSettings(apvts);
+    analyserTap.push(AnalyserTap::preEQ, buffer, totalNumInputChannels);
     
-    updatePeakFilters(chainSettings);
+    const CoefficientBank* publishedBank;
+    
+    {
+        ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::parameterFetch);
+        publishedBank = coefficientExchange.pickUpLatest();
+        fetchSettings();
+    }
+    
+    {
+        ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+        applyPublishedPeakFilters(publishedBank);
+    }
     
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
     
-    juce::dsp::AudioBlock<float> block(buffer);
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    auto channelBlock = block.getSubsetChannelBlock(0, (size_t) totalNumInputChannels);
+    
+    // Set by the host before prepareToPlay(), so it always matches the buffers it sends
+    auto& engines = getEngines<SampleType>();
+    
+    auto interval = smoothingInterval.load();
+    auto const numSamples = buffer.getNumSamples();
+    
+    // Once the input has been silent for longer than the filters ring, the buffer already holds the output
+    silentSamples = isSilent(buffer, totalNumInputChannels) ? silentSamples + numSamples : 0;
+    bool const skipped = silentSamples - numSamples >= tailLengthSamples;
+    
+    if (skipped) {
+        // Whatever is left in the filter states is below the silence threshold by now, so it can go
+        if (! isIdle) {
+            engines.reset();
+            bandDetector.reset();
+            isIdle = true;
+        }
+        
+        // Parameter changes still land, without any smoothing since there's nothing to hear
+        ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+        updateChangedPeakFilters();
+    } else if (interval > 0 || anyBandDynamic) {
+        isIdle = false;
+        processSmoothed(engines, channelBlock, interval > 0 ? interval : dynamicsInterval);
+    } else {
+        isIdle = false;
+        
+        {
+            ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+            updateChangedPeakFilters();
+        }
+        
+        processWithActiveEngine(engines, channelBlock);
+    }
+    
+    if (tailLengthNeedsUpdate) {
+        ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+        updateTailLength();
+    }
+    
+    analyserTap.push(AnalyserTap::postEQ, buffer, totalNumInputChannels);
+    
+    processingStats.endBlock(numSamples, skipped, allocationCounter.getCount(), LockCounter::getCountOnThisThread() - locksBefore);
+}
+
+template <typename SampleType>
+bool GraphicEQAudioProcessor::isSilent(const juce::AudioBuffer<SampleType>& buffer, int numChannels)
+{
+    for (int channel = 0; channel < numChannels; ++channel) {
+        if (buffer.getMagnitude(channel, 0, buffer.getNumSamples()) > (SampleType) silenceThreshold)
+            return false;
+    }
+    
+    return true;
+}
+
+template <typename SampleType>
+void GraphicEQAudioProcessor::processSmoothed(FilterEngines<SampleType>& engines, const juce::dsp::AudioBlock<SampleType>& block, int interval)
+{
+    // Coefficient updates sit on a fixed grid of `interval` samples that carries on across host blocks,
+    // each one starting a ramp that lasts exactly until the next
+    auto const numSamples = (int) block.getNumSamples();
+    samplesUntilSmoothingUpdate = juce::jmin(samplesUntilSmoothingUpdate, interval);
+    
+    for (int start = 0; start < numSamples;) {
+        if (samplesUntilSmoothingUpdate == 0) {
+            ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+            updateSmoothedPeakFilters(interval);
+            samplesUntilSmoothingUpdate = interval;
+        }
+        
+        auto length = juce::jmin(numSamples - start, samplesUntilSmoothingUpdate);
+        auto subBlock = block.getSubBlock((size_t) start, (size_t) length);
+        
+        // The detectors hear the input; the gains they lead to start with the next update
+        if (anyBandDynamic) {
+            ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+            bandDetector.process(subBlock);
+        }
+        
+        processWithActiveEngine(engines, subBlock);
+        
+        start += length;
+        samplesUntilSmoothingUpdate -= length;
+    }
+}
+
+template <typename SampleType>
+void GraphicEQAudioProcessor::processWithActiveEngine(FilterEngines<SampleType>& engines, const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto engine = filterEngine.load();
+    
+    // The engines' states aren't interchangeable, so whichever one takes over starts from silence
+    if (engine != engines.activeEngine) {
+        if (engine == FilterEngine::parallel)
+            engines.parallelCascade.reset();
+        else if (engine == FilterEngine::svf)
+            engines.svfCascade.reset();
+        else if (engine == FilterEngine::linearPhase)
+            linearPhaseEQ.reset();
+        else
+            engines.cascade.reset();
+        
+        engines.activeEngine = engine;
+        tailLengthNeedsUpdate = true;
+    }
+    
+    if (engine == FilterEngine::linearPhase) {
+        // The kernel follows the gains on the designer thread, this only passes them on
+        linearPhaseEQ.setGains(appliedBandGains.data());
+        processLinearPhase(block);
+        
+        engines.cascade.finishBlock((int) block.getNumSamples());
+        engines.svfCascade.finishBlock((int) block.getNumSamples());
+        return;
+    }
     
-    if (totalNumInputChannels > 1) {
-        auto leftBlock = block.getSingleChannelBlock(0);
-        auto rightBlock = block.getSingleChannelBlock(1);
+    if (engine == FilterEngine::parallel && engines.parallelFormNeedsUpdate) {
+        ProcessingStats::ScopedPhase phase(processingStats, ProcessingStats::Phase::coefficientUpdate);
+        processingStats.countParallelFormUpdate();
         
-        juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-        juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+        engines.parallelFormIsValid = engines.parallelCascade.setCoefficients(bandCoefficientArrays.data(), numBands);
+        engines.parallelFormNeedsUpdate = false;
+    }
+    
+    // If the expansion ever fails the cascade still gives the right answer
+    auto const processingEngine = engine == FilterEngine::parallel && ! engines.parallelFormIsValid ? FilterEngine::cascade : engine;
+    engines.processingEngine = processingEngine;
+    
+    bool const passThrough = (processingEngine == FilterEngine::cascade && engines.cascade.isPassThrough())
+                          || (processingEngine == FilterEngine::svf && engines.svfCascade.isPassThrough());
+    
+    if (! passThrough) {
+        engines.currentBlock = block;
+        auto numTasks = processingEngine == FilterEngine::parallel ? engines.parallelCascade.getNumChannels(block)
+                      : processingEngine == FilterEngine::svf      ? engines.svfCascade.getNumGroups(block)
+                                                                   : engines.cascade.getNumGroups(block);
         
-        leftChain.process(leftContext);
-        rightChain.process(rightContext);
+        if (workerPool != nullptr) {
+            workerPool->run(numTasks, (int) block.getNumSamples(), processTask<SampleType>, this);
+        } else {
+            for (int i = 0; i < numTasks; ++i)
+                processTask<SampleType>(this, i);
+        }
+    }
+    
+    // Every engine gets to finish, so coefficient ramps keep moving whichever one is doing the work
+    engines.cascade.finishBlock((int) block.getNumSamples());
+    engines.svfCascade.finishBlock((int) block.getNumSamples());
+}
+
+void GraphicEQAudioProcessor::prepareLinearPhase(const float* gainsInDecibels)
+{
+    linearPhaseEQ.prepare(linearPhaseSpec, Bands::freqs.data(), Bands::qualities.data(), gainsInDecibels, numBands);
+    
+    if (isUsingDoublePrecision())
+        linearPhaseScratch.setSize((int) linearPhaseSpec.numChannels, (int) linearPhaseSpec.maximumBlockSize);
+    
+    linearPhaseIsPrepared = true;
+}
+
+template <typename SampleType>
+void GraphicEQAudioProcessor::processLinearPhase(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    if constexpr (std::is_same_v<SampleType, float>) {
+        linearPhaseEQ.process(block);
     } else {
-        auto monoBlock = block.getSingleChannelBlock(0);
-        juce::dsp::ProcessContextReplacing<float> monoContext(monoBlock);
-        leftChain.process(monoContext);
+        auto const numChannels = block.getNumChannels();
+        auto const numSamples = block.getNumSamples();
+        auto scratch = juce::dsp::AudioBlock<float>(linearPhaseScratch).getSubBlock(0, numSamples).getSubsetChannelBlock(0, numChannels);
+        
+        for (size_t channel = 0; channel < numChannels; ++channel)
+            std::copy_n(block.getChannelPointer(channel), numSamples, scratch.getChannelPointer(channel));
+        
+        linearPhaseEQ.process(scratch);
+        
+        for (size_t channel = 0; channel < numChannels; ++channel)
+            std::copy_n(scratch.getChannelPointer(channel), numSamples, block.getChannelPointer(channel));
     }
 }
 
+template <typename SampleType>
+void GraphicEQAudioProcessor::processTask(void* context, int taskIndex)
+{
+    auto& processor = *static_cast<GraphicEQAudioProcessor*>(context);
+    auto& engines = processor.getEngines<SampleType>();
+    
+    switch (engines.processingEngine) {
+        case FilterEngine::parallel: engines.parallelCascade.processChannel(engines.currentBlock, taskIndex); break;
+        case FilterEngine::svf:      engines.svfCascade.processGroup(engines.currentBlock, taskIndex); break;
+        case FilterEngine::cascade:  engines.cascade.processGroup(engines.currentBlock, taskIndex); break;
+        case FilterEngine::linearPhase: jassertfalse; break; // never goes through the worker pool
+    }
+}
+
+void GraphicEQAudioProcessor::setSmoothingInterval(int numSamples)
+{
+    smoothingInterval = juce::jmax(0, numSamples);
+    apvts.state.setProperty("SmoothingInterval", smoothingInterval.load(), nullptr);
+}
+
+void GraphicEQAudioProcessor::setMultithreadingEnabled(bool shouldBeEnabled)
+{
+    multithreadingEnabled = shouldBeEnabled;
+    apvts.state.setProperty("Multithreading", shouldBeEnabled, nullptr);
+    
+    // Otherwise prepareToPlay() will take care of it
+    if (getSampleRate() > 0.0)
+        updateWorkerPool();
+}
+
+void GraphicEQAudioProcessor::updateWorkerPool()
+{
+    // Enough workers that every channel could have a core to itself, without oversubscribing the machine
+    auto numWorkers = multithreadingEnabled ? juce::jmin(juce::SystemStats::getNumCpus() - 1, getTotalNumInputChannels() - 1) : 0;
+    auto currentNumWorkers = workerPool != nullptr ? workerPool->getNumWorkers() : 0;
+    
+    // Workers keep spinning for a little longer than a block before they park
+    auto spinTime = getSampleRate() > 0.0 ? 1.5 * getBlockSize() / getSampleRate() : 0.002;
+    
+    if (numWorkers == currentNumWorkers) {
+        if (workerPool != nullptr)
+            workerPool->setSpinTime(spinTime);
+        
+        return;
+    }
+    
+    std::unique_ptr<ChannelWorkerPool> newPool;
+    
+    if (numWorkers > 0) {
+        newPool = std::make_unique<ChannelWorkerPool>(numWorkers);
+        newPool->setSpinTime(spinTime);
+    }
+    
+    {
+        const juce::ScopedLock sl(getCallbackLock());
+        std::swap(workerPool, newPool);
+    }
+    
+    // The old pool, if any, is shut down here, outside the callback lock
+}
+
+void GraphicEQAudioProcessor::setFilterEngine(FilterEngine engine)
+{
+    // The audio thread only touches the linear phase engine once it's selected, so it's safe to prepare
+    // here first. Before prepareToPlay() there's nothing to prepare it for, that catches up instead.
+    if (engine == FilterEngine::linearPhase && ! linearPhaseIsPrepared && linearPhaseSpec.sampleRate > 0.0) {
+        auto const gains = getChainSettings(apvts).bandGains;
+        prepareLinearPhase(gains.data());
+    }
+    
+    filterEngine = engine;
+    apvts.state.setProperty("FilterEngine", (int) engine, nullptr);
+    updateLatency();
+}
+
+void GraphicEQAudioProcessor::setLinearPhaseKernelLength(int numSamples)
+{
+    linearPhaseEQ.setKernelLength(numSamples);
+    apvts.state.setProperty("LinearPhaseKernelLength", linearPhaseEQ.getKernelLength(), nullptr);
+    
+    // The latency only changes once the new kernel is running, see handleAsyncUpdate()
+    tailLengthNeedsUpdate = true;
+}
+
+void GraphicEQAudioProcessor::updateLatency()
+{
+    setLatencySamples(filterEngine.load() == FilterEngine::linearPhase ? linearPhaseEQ.getLatencySamples() : 0);
+}
+
 //==============================================================================
 bool GraphicEQAudioProcessor::hasEditor() const
 {
@@ -203,8 +553,25 @@ void GraphicEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     
     // Personal Note: This and setStateInformation() below are what enable the plugin parameters to be saved when not opened!
     
-    juce::MemoryOutputStream mos(destData, true);
-    apvts.state.writeToStream(mos);
+    auto const chainSettings = getChainSettings(apvts);
+    
+    PluginState state;
+    state.bandGains = chainSettings.bandGains;
+    state.bandDynamic = chainSettings.bandDynamic;
+    state.bandThresholds = chainSettings.bandThresholds;
+    state.dynamicAttackMs = chainSettings.dynamicAttackMs;
+    state.dynamicReleaseMs = chainSettings.dynamicReleaseMs;
+    state.filterEngine = (int) getFilterEngine();
+    state.multithreading = isMultithreadingEnabled();
+    state.smoothingInterval = getSmoothingInterval();
+    state.linearPhaseKernelLength = getLinearPhaseKernelLength();
+    state.currentPreset = getCurrentProgram();
+    
+    for (int i = 0; i < PresetBank::numPresets; ++i) {
+        state.presetIsUsed[i] = presetBank.getGains(i, state.presetGains[i]);
+    }
+    
+    state.writeTo(destData);
 }
 
 void GraphicEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -212,61 +579,339 @@ void GraphicEQAudioProcessor::setStateInformation (const void* data, int sizeInB
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
     
+    // What getStateInformation() writes now. A compact state from another band layout doesn't load at all.
+    if (PluginState::hasMagic(data, sizeInBytes)) {
+        PluginState state;
+        
+        if (state.readFrom(data, sizeInBytes))
+            loadState(state);
+        
+        return;
+    }
+    
+    // Older versions saved the whole ValueTree, and the batch renderer still turns XML presets into one
     auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
     if (tree.isValid()) {
         apvts.replaceState(tree);
         
+        setFilterEngine((FilterEngine) (int) apvts.state.getProperty("FilterEngine", (int) FilterEngine::cascade));
+        setLinearPhaseKernelLength(apvts.state.getProperty("LinearPhaseKernelLength", LinearPhaseEQ::defaultKernelLength));
+        setMultithreadingEnabled(apvts.state.getProperty("Multithreading", false));
+        setSmoothingInterval(apvts.state.getProperty("SmoothingInterval", 0));
+        
+        // Never write to the filters from here, the audio thread may be using them right now
         auto chainSettings = getChainSettings(apvts);
-        updatePeakFilters(chainSettings);
+        publishPeakFilters(chainSettings);
+    }
+}
+
+void GraphicEQAudioProcessor::loadState(const PluginState& state)
+{
+    auto const engine = juce::jlimit((int) FilterEngine::cascade, (int) FilterEngine::linearPhase, state.filterEngine);
+    
+    setFilterEngine((FilterEngine) engine);
+    setLinearPhaseKernelLength(state.linearPhaseKernelLength);
+    setMultithreadingEnabled(state.multithreading);
+    setSmoothingInterval(state.smoothingInterval);
+    
+    for (int i = 0; i < PresetBank::numPresets; ++i) {
+        if (state.presetIsUsed[i])
+            presetBank.store(i, state.presetGains[i]);
+        else
+            presetBank.clear(i);
     }
+    
+    currentProgram = juce::jlimit(0, PresetBank::numPresets - 1, state.currentPreset);
+    
+    // A state from before the dynamic EQ existed leaves it as a new instance would have it
+    for (int i = 0; i < numBands; ++i) {
+        auto* dynamic = apvts.getParameter(getDynamicParameterID(i));
+        auto* threshold = apvts.getParameter(getThresholdParameterID(i));
+        
+        dynamic->setValueNotifyingHost(state.hasDynamics ? (state.bandDynamic[i] ? 1.0f : 0.0f) : dynamic->getDefaultValue());
+        threshold->setValueNotifyingHost(state.hasDynamics ? threshold->convertTo0to1(state.bandThresholds[i]) : threshold->getDefaultValue());
+    }
+    
+    auto* attack = apvts.getParameter(attackParameterID);
+    auto* release = apvts.getParameter(releaseParameterID);
+    attack->setValueNotifyingHost(state.hasDynamics ? attack->convertTo0to1(state.dynamicAttackMs) : attack->getDefaultValue());
+    release->setValueNotifyingHost(state.hasDynamics ? release->convertTo0to1(state.dynamicReleaseMs) : release->getDefaultValue());
+    
+    setBandGains(state.bandGains);
+    
+    // Never write to the filters from here, the audio thread may be using them right now
+    ChainSettings chainSettings;
+    chainSettings.bandGains = state.bandGains;
+    publishPeakFilters(chainSettings);
+}
+
+void GraphicEQAudioProcessor::setBandGains(const std::array<float, numBands>& gains)
+{
+    for (int i = 0; i < numBands; ++i) {
+        auto* parameter = bandParameters[i];
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(gains[i]));
+    }
+}
+
+void GraphicEQAudioProcessor::storePreset(int index)
+{
+    presetBank.store(index, getChainSettings(apvts).bandGains);
+}
+
+void GraphicEQAudioProcessor::clearPreset(int index)
+{
+    presetBank.clear(index);
+}
+
+bool GraphicEQAudioProcessor::recallPreset(int index)
+{
+    return morphPresets(index, index, 0.0f);
+}
+
+bool GraphicEQAudioProcessor::morphPresets(int fromIndex, int toIndex, float amount)
+{
+    CoefficientBank morph;
+    
+    if (! presetBank.getMorph(fromIndex, toIndex, amount, morph.bandGains, morph.coefficients, morph.sampleRate))
+        return false;
+    
+    // Parameters first: by the time the audio thread picks the bank up, the gains it fetches match it,
+    // so nothing gets recomputed there
+    setBandGains(morph.bandGains);
+    
+    // Until prepareToPlay() picks a table up, the parameters are all there is to change
+    if (morph.sampleRate > 0.0) {
+        coefficientExchange.publish([&](CoefficientBank& bank)
+        {
+            bank = morph;
+        });
+    }
+    
+    return true;
 }
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 {
     ChainSettings chainSettings;
     
-    for (int i = 0; i < chainSettings.bandGains.size(); ++i) {
-        chainSettings.bandGains[i] = apvts.getRawParameterValue(allBandNames[i])->load();
+    for (int i = 0; i < numBands; ++i) {
+        chainSettings.bandGains[i] = apvts.getRawParameterValue(Bands::names[i])->load();
+        chainSettings.bandDynamic[i] = apvts.getRawParameterValue(GraphicEQAudioProcessor::getDynamicParameterID(i))->load() >= 0.5f;
+        chainSettings.bandThresholds[i] = apvts.getRawParameterValue(GraphicEQAudioProcessor::getThresholdParameterID(i))->load();
     }
     
+    chainSettings.dynamicAttackMs = apvts.getRawParameterValue(GraphicEQAudioProcessor::attackParameterID)->load();
+    chainSettings.dynamicReleaseMs = apvts.getRawParameterValue(GraphicEQAudioProcessor::releaseParameterID)->load();
+    
     return chainSettings;
 }
 
 void GraphicEQAudioProcessor::updatePeakFilters(const ChainSettings &chainSettings)
 {
-    using Coefficients = Filter::CoefficientsPtr;
-    std::vector<Coefficients> bandCoefficients;
+    for (int i = 0; i < numBands; ++i) {
+        updateBandCoefficients(i, chainSettings.bandGains[i]);
+    }
+    
+    appliedSampleRate = getSampleRate();
+}
+
+void GraphicEQAudioProcessor::fetchSettings()
+{
+    anyBandDynamic = false;
     
-    for (int i = 0; i < allBandNames.size(); ++i) {
-        bandCoefficients.push_back(juce::dsp::IIR::Coefficients<float>::makePeakFilter(getSampleRate(),
-                                                                                    chainSettings.bandFreqs[i],
-                                                                                    chainSettings.bandQualities[i],
-                                                                                    juce::Decibels::decibelsToGain(chainSettings.bandGains[i])));
+    for (int i = 0; i < numBands; ++i) {
+        fetchedSettings.bandGains[i] = bandGainValues[i]->load();
+        fetchedSettings.bandDynamic[i] = bandDynamicValues[i]->load() >= 0.5f;
+        fetchedSettings.bandThresholds[i] = bandThresholdValues[i]->load();
+        anyBandDynamic = anyBandDynamic || fetchedSettings.bandDynamic[i];
     }
     
-    updateChainCoefficients(leftChain, bandCoefficients);
-    updateChainCoefficients(rightChain, bandCoefficients);
+    fetchedSettings.dynamicAttackMs = dynamicAttackValue->load();
+    fetchedSettings.dynamicReleaseMs = dynamicReleaseValue->load();
+    bandDetector.setTimes(fetchedSettings.dynamicAttackMs, fetchedSettings.dynamicReleaseMs);
 }
 
-void GraphicEQAudioProcessor::updateChainCoefficients(MonoChain &chain, std::vector<Coefficients> &bandCoefficients)
+void GraphicEQAudioProcessor::updateTargetGains()
 {
-    updateCoefficients(chain.get<ChainPositions::band20>().coefficients, bandCoefficients[0]);
-    updateCoefficients(chain.get<ChainPositions::band32>().coefficients, bandCoefficients[1]);
-    updateCoefficients(chain.get<ChainPositions::band64>().coefficients, bandCoefficients[2]);
-    updateCoefficients(chain.get<ChainPositions::band125>().coefficients, bandCoefficients[3]);
-    updateCoefficients(chain.get<ChainPositions::band250>().coefficients, bandCoefficients[4]);
-    updateCoefficients(chain.get<ChainPositions::band500>().coefficients, bandCoefficients[5]);
-    updateCoefficients(chain.get<ChainPositions::band1k>().coefficients, bandCoefficients[6]);
-    updateCoefficients(chain.get<ChainPositions::band2k>().coefficients, bandCoefficients[7]);
-    updateCoefficients(chain.get<ChainPositions::band4k>().coefficients, bandCoefficients[8]);
-    updateCoefficients(chain.get<ChainPositions::band8k>().coefficients, bandCoefficients[9]);
-    updateCoefficients(chain.get<ChainPositions::band16k>().coefficients, bandCoefficients[10]);
-    updateCoefficients(chain.get<ChainPositions::band20k>().coefficients, bandCoefficients[11]);
+    for (int i = 0; i < numBands; ++i) {
+        auto gain = fetchedSettings.bandGains[i];
+        
+        // From flat at the threshold to the full gain dynamicsRangeDecibels above it
+        if (fetchedSettings.bandDynamic[i]) {
+            auto const overshoot = bandDetector.getLevelDecibels(i) - fetchedSettings.bandThresholds[i];
+            gain *= juce::jlimit(0.0f, 1.0f, overshoot / dynamicsRangeDecibels);
+        }
+        
+        targetBandGains[i] = gain;
+    }
+}
+
+void GraphicEQAudioProcessor::updateChangedPeakFilters()
+{
+    // Called once per block: only bands whose gain moved since the last block get recomputed
+    bool const sampleRateChanged = getSampleRate() != appliedSampleRate;
+    updateTargetGains();
+    
+    for (int i = 0; i < numBands; ++i) {
+        auto gain = targetBandGains[i];
+        
+        if (sampleRateChanged || gain != appliedBandGains[i]) {
+            updateBandCoefficients(i, gain);
+        }
+    }
+    
+    appliedSampleRate = getSampleRate();
+}
+
+void GraphicEQAudioProcessor::updateSmoothedPeakFilters(int rampLength)
+{
+    // A new sample rate invalidates everything, which is a job for the plain update
+    if (getSampleRate() != appliedSampleRate) {
+        updateChangedPeakFilters();
+        return;
+    }
+    
+    updateTargetGains();
+    
+    // Without smoothing this grid is only here for the dynamic bands, and everything else steps as usual
+    bool const smoothStaticBands = smoothingInterval.load() > 0;
+    
+    for (int i = 0; i < numBands; ++i) {
+        auto& smoothedGain = smoothedBandGains[i];
+        
+        // Straight to the new gain's coefficients, the same way updateChangedPeakFilters() gets there
+        if (! fetchedSettings.bandDynamic[i] && ! smoothStaticBands) {
+            if (targetBandGains[i] != appliedBandGains[i])
+                updateBandCoefficients(i, targetBandGains[i]);
+            
+            continue;
+        }
+        
+        // A dynamic band's envelope has attack and release of its own, smoothing on top would only slow it down
+        if (fetchedSettings.bandDynamic[i])
+            smoothedGain.setCurrentAndTargetValue(targetBandGains[i]);
+        else
+            smoothedGain.setTargetValue(targetBandGains[i]);
+        
+        auto gain = smoothedGain.isSmoothing() ? smoothedGain.skip(rampLength) : smoothedGain.getCurrentValue();
+        
+        if (gain == appliedBandGains[i]) {
+            continue;
+        }
+        
+        // Smoothed gains fall between the table's steps; interpolating the neighbours is far cheaper than
+        // makePeakFilter() and the cascade's ramp interpolates from there down to every sample
+        bandCoefficientArrays[i] = coefficientTable->getInterpolatedCoefficients(i, gain);
+        forActiveEngines([&](auto& engines)
+        {
+            engines.cascade.rampCoefficients(i, bandCoefficientArrays[i], rampLength);
+            engines.svfCascade.rampGain(i, gain, rampLength);
+            engines.parallelFormNeedsUpdate = true;
+        });
+        
+        processingStats.countCoefficientUpdate();
+        tailLengthNeedsUpdate = true;
+        appliedBandGains[i] = gain;
+    }
 }
 
-void GraphicEQAudioProcessor::updateCoefficients(Filter::CoefficientsPtr &old, const Filter::CoefficientsPtr &replacements)
+void GraphicEQAudioProcessor::updateTailLength()
 {
-    *old = *replacements;
+    // The slowest pole of any band that isn't flat decides how long the output rings on after the input stops
+    double longestDecay = 0.0;
+    
+    for (auto const& c : bandCoefficientArrays) {
+        if (c[0] == c[3] && c[1] == c[4] && c[2] == c[5])
+            continue;
+        
+        longestDecay = juce::jmax(longestDecay, getDecaySamples(c[4] / c[3], c[5] / c[3]));
+    }
+    
+    // The FIR rings for exactly its length, whatever the gains
+    if (filterEngine.load() == FilterEngine::linearPhase)
+        longestDecay = juce::jmax(longestDecay, (double) linearPhaseEQ.getKernelLength());
+    
+    tailLengthSamples = (juce::int64) std::ceil(longestDecay);
+    tailLengthSeconds = getSampleRate() > 0.0 ? longestDecay / getSampleRate() : 0.0;
+    tailLengthNeedsUpdate = false;
+}
+
+double GraphicEQAudioProcessor::getDecaySamples(double a1, double a2)
+{
+    // Largest pole radius of z^2 + a1 z + a2. The lowest bands have poles closest to the unit circle, a boost
+    // (narrower bell) moves them closer still.
+    auto const discriminant = a1 * a1 - 4.0 * a2;
+    auto const radius = discriminant < 0.0 ? std::sqrt(a2) : 0.5 * (std::abs(a1) + std::sqrt(discriminant));
+    
+    jassert(radius < 1.0);
+    
+    if (radius <= 0.0)
+        return 0.0;
+    
+    // Solves n r^n = threshold rather than r^n = threshold, which also covers the double pole of a cut at Q 0.5
+    auto const logRadius = std::log(juce::jmin(radius, 1.0 - 1.0e-12));
+    auto const logThreshold = std::log(silenceThreshold);
+    auto n = logThreshold / logRadius;
+    
+    for (int i = 0; i < 4; ++i)
+        n = (logThreshold - std::log(juce::jmax(1.0, n))) / logRadius;
+    
+    return n;
+}
+
+void GraphicEQAudioProcessor::updateBandCoefficients(int bandIndex, float gainInDecibels)
+{
+    // The table hands back plain arrays, so unlike Coefficients::makePeakFilter() nothing here allocates
+    applyBandCoefficients(bandIndex, gainInDecibels, coefficientTable->getCoefficients(bandIndex, gainInDecibels));
+}
+
+void GraphicEQAudioProcessor::applyBandCoefficients(int bandIndex, float gainInDecibels, const std::array<double, 6>& coefficients)
+{
+    bandCoefficientArrays[bandIndex] = coefficients;
+    
+    forActiveEngines([&](auto& engines)
+    {
+        engines.cascade.setCoefficients(bandIndex, coefficients);
+        engines.svfCascade.setGain(bandIndex, gainInDecibels);
+        engines.parallelFormNeedsUpdate = true;
+    });
+    
+    processingStats.countCoefficientUpdate();
+    tailLengthNeedsUpdate = true;
+    appliedBandGains[bandIndex] = gainInDecibels;
+    
+    // Whatever was smoothing towards the old value is overruled by a direct change
+    smoothedBandGains[bandIndex].setCurrentAndTargetValue(gainInDecibels);
+}
+
+void GraphicEQAudioProcessor::publishPeakFilters(const ChainSettings& chainSettings)
+{
+    // Before prepareToPlay() there's nothing to publish to, the bands get computed there anyway
+    if (coefficientTable == nullptr)
+        return;
+    
+    coefficientExchange.publish([&](CoefficientBank& bank)
+    {
+        bank.sampleRate = getSampleRate();
+        bank.bandGains = chainSettings.bandGains;
+        
+        for (int i = 0; i < numBands; ++i) {
+            bank.coefficients[i] = coefficientTable->getCoefficients(i, chainSettings.bandGains[i]);
+        }
+    });
+}
+
+void GraphicEQAudioProcessor::applyPublishedPeakFilters(const CoefficientBank* bank)
+{
+    // A bank made for another sample rate is stale; the per-block check below recomputes from the parameters instead
+    if (bank == nullptr || bank->sampleRate != getSampleRate())
+        return;
+    
+    for (int i = 0; i < numBands; ++i) {
+        if (bank->bandGains[i] != appliedBandGains[i]) {
+            applyBandCoefficients(i, bank->bandGains[i], bank->coefficients[i]);
+        }
+    }
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout GraphicEQAudioProcessor::createParameterLayout()
@@ -280,13 +925,33 @@ juce::AudioProcessorValueTreeState::ParameterLayout GraphicEQAudioProcessor::cre
     defaultValue = 0.0f;
     
     // All bands should probably be duplicates with different names...
-    for (juce::String bandName : allBandNames) {
+    for (juce::String bandName : Bands::names) {
         parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(bandName, 1),
                                                                         bandName,
                                                                         juce::NormalisableRange<float>(rangeStart, rangeEnd, intervalValue, skewFactor),
                                                                         defaultValue));
     }
     
+    // Dynamic EQ, off for every band unless it's switched on; appended so the bands' IDs and order stay as they were
+    for (int i = 0; i < numBands; ++i) {
+        parameterLayout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID(getDynamicParameterID(i), 1),
+                                                                       getDynamicParameterID(i),
+                                                                       false));
+        parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(getThresholdParameterID(i), 1),
+                                                                        getThresholdParameterID(i),
+                                                                        juce::NormalisableRange<float>(-60.f, 0.f, 0.5f),
+                                                                        -24.f));
+    }
+    
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(attackParameterID, 1),
+                                                                    attackParameterID,
+                                                                    juce::NormalisableRange<float>(0.1f, 100.f, 0.1f, 0.4f),
+                                                                    5.f));
+    parameterLayout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID(releaseParameterID, 1),
+                                                                    releaseParameterID,
+                                                                    juce::NormalisableRange<float>(5.f, 2000.f, 1.f, 0.4f),
+                                                                    100.f));
+    
     return parameterLayout;
 }
 
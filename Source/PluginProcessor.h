@@ -9,98 +9,306 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "BandLayout.h"
+#include "PeakCoefficientTable.h"
+#include "SIMDCascade.h"
+#include "ParallelCascade.h"
+#include "SVFCascade.h"
+#include "LinearPhaseEQ.h"
+#include "ChannelWorkerPool.h"
+#include "CoefficientExchange.h"
+#include "ProcessingStats.h"
+#include "AnalyserTap.h"
+#include "PresetBank.h"
+#include "PluginState.h"
+#include "BandDetector.h"
 
+static constexpr int numBands = Bands::numBands;
+
+// Fixed-size so that reading the settings never touches the heap (it happens on the audio thread).
+// Frequencies, Qs and names are the same for every instance, they're read straight from Bands.
 struct ChainSettings {
-    std::vector<float> bandGains {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    std::vector<float> const bandFreqs {20.f, 32.f, 64.f, 125.f, 250.f, 500.f, 1000.f, 2000.f, 4000.f, 8000.f, 16000.f, 20000.f};
-    std::vector<float> const bandQualities {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+    std::array<float, numBands> bandGains {};
+    
+    // A dynamic band only moves towards its gain while its part of the input is above the threshold
+    std::array<bool, numBands> bandDynamic {};
+    std::array<float, numBands> bandThresholds {};
+    float dynamicAttackMs = 0.0f;
+    float dynamicReleaseMs = 0.0f;
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-static std::vector<juce::String> const allBandNames {"Band 20", "Band 32", "Band 64", "Band 125",
-                                    "Band 250", "Band 500", "Band 1k", "Band 2k",
-                                    "Band 4k", "Band 8k", "Band 16k", "Band 20k"};
-
 //==============================================================================
 /**
 */
-class GraphicEQAudioProcessor  : public juce::AudioProcessor
+class GraphicEQAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::AsyncUpdater
 {
 public:
     //==============================================================================
     GraphicEQAudioProcessor();
     ~GraphicEQAudioProcessor() override;
-
+    
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
-
+   
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
-
+   
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    
+    // Every engine is templated on the sample type, so a 64-bit host's buffers are processed as they are
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+    
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
-
+    
     //==============================================================================
     const juce::String getName() const override;
-
+    
     bool acceptsMidi() const override;
     bool producesMidi() const override;
     bool isMidiEffect() const override;
     double getTailLengthSeconds() const override;
-
+    
     //==============================================================================
     int getNumPrograms() override;
     int getCurrentProgram() override;
     void setCurrentProgram (int index) override;
     const juce::String getProgramName (int index) override;
     void changeProgramName (int index, const juce::String& newName) override;
-
+    
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    // The dynamic EQ's parameter IDs; per band ones are derived from the band's own ID
+    static juce::String getDynamicParameterID(int bandIndex) { return juce::String(Bands::names[bandIndex]) + " Dynamic"; }
+    static juce::String getThresholdParameterID(int bandIndex) { return juce::String(Bands::names[bandIndex]) + " Threshold"; }
+    static constexpr char const* attackParameterID = "Dynamic Attack";
+    static constexpr char const* releaseParameterID = "Dynamic Release";
+    
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    
+    // Different realisations of the same response, picked per instance and saved with the state
+    enum class FilterEngine
+    {
+        cascade,    // serial biquads, channels side by side in SIMD lanes
+        parallel,   // partial fraction expansion, bands side by side in SIMD lanes (best for mono)
+        svf,        // TPT state-variable bells: cheap gain changes, accurate low bands at high sample rates
+        linearPhase // FIR with the same magnitude response and no phase shift, at the cost of latency
+    };
+    
+    void setFilterEngine(FilterEngine engine);
+    FilterEngine getFilterEngine() const { return filterEngine.load(); }
+    
+    // Length of the linear phase kernel; half of it is the latency while that engine is selected
+    void setLinearPhaseKernelLength(int numSamples);
+    int getLinearPhaseKernelLength() const { return linearPhaseEQ.getKernelLength(); }
+    
+    // 0 applies gain changes as a step at the start of each block. Otherwise gains glide to their targets,
+    // with the coefficients recomputed every this many samples and interpolated in between.
+    void setSmoothingInterval(int numSamples);
+    int getSmoothingInterval() const { return smoothingInterval.load(); }
+    
+    // Opt-in: spreads channel groups over a pool of worker threads, worth it for very wide layouts
+    void setMultithreadingEnabled(bool shouldBeEnabled);
+    bool isMultithreadingEnabled() const { return multithreadingEnabled.load(); }
+    
+    // Blocks that were passed straight through because the input was silent and the filters had rung out
+    juce::uint64 getNumSkippedBlocks() const { return processingStats.getNumSkippedBlocks(); }
+    
+    // Timing and real-time safety counters of this instance's audio thread, readable from any thread
+    ProcessingStats& getProcessingStats() { return processingStats; }
+    
+    // The signal before and after the EQ, for the editor's analyser; idle unless an analyser activates it
+    AnalyserTap& getAnalyserTap() { return analyserTap; }
+    
+    // The programs the host sees. Any thread but the audio thread: the bands' parameters are set
+    // straight away, and the audio thread swaps in the preset's precomputed coefficients at the
+    // start of its next block. Recalling or morphing to an empty preset does nothing.
+    void storePreset(int index);
+    void clearPreset(int index);
+    bool recallPreset(int index);
+    bool morphPresets(int fromIndex, int toIndex, float amount);
+    bool isPresetUsed(int index) const { return presetBank.isUsed(index); }
 
 private:
-    using Filter = juce::dsp::IIR::Filter<float>;
+    // One set of engines per sample type. Only the set for the precision the host picked is prepared
+    // and kept up to date; the host can only change precision before prepareToPlay(), which catches up.
+    template <typename SampleType>
+    struct FilterEngines
+    {
+        // Both channels (and any others) run through one cascade, one channel per SIMD lane
+        SIMDCascade<SampleType> cascade;
+        ParallelCascade<SampleType> parallelCascade;
+        SVFCascade<SampleType> svfCascade;
+        
+        FilterEngine activeEngine = FilterEngine::cascade;
+        FilterEngine processingEngine = FilterEngine::cascade;
+        
+        // The parallel form is derived from all bands at once, so it's redone once per block at most
+        bool parallelFormNeedsUpdate = true;
+        bool parallelFormIsValid = false;
+        
+        juce::dsp::AudioBlock<SampleType> currentBlock;
+        
+        void reset()
+        {
+            cascade.reset();
+            parallelCascade.reset();
+            svfCascade.reset();
+        }
+    };
     
-    // Specific to cut filters with 4 options for filters i.e. 12 dB/oct, 24 dB/oct, etc
-    // using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+    FilterEngines<float> floatEngines;
+    FilterEngines<double> doubleEngines;
     
-    // Mono Chain represents our mono signal path
-    using MonoChain = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter, Filter>;
-    // Need 2 for stereo
-    MonoChain leftChain, rightChain;
+    template <typename SampleType>
+    FilterEngines<SampleType>& getEngines()
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleEngines;
+        else
+            return floatEngines;
+    }
     
-    // needed for indices of chain parameters when updating chain values in DSP
-    enum ChainPositions
+    template <typename Function>
+    void forActiveEngines(Function&& function)
     {
-        band20,
-        band32,
-        band64,
-        band125,
-        band250,
-        band500,
-        band1k,
-        band2k,
-        band4k,
-        band8k,
-        band16k,
-        band20k
-    };
+        if (isUsingDoublePrecision())
+            function(doubleEngines);
+        else
+            function(floatEngines);
+    }
+    
+    std::atomic<FilterEngine> filterEngine {FilterEngine::cascade};
+    
+    std::array<std::array<double, 6>, numBands> bandCoefficientArrays;
+    
+    // Float only, like juce::dsp::Convolution; double buffers go through the scratch buffer
+    LinearPhaseEQ linearPhaseEQ;
+    juce::AudioBuffer<float> linearPhaseScratch;
+    
+    // Only prepared while it's the selected engine, so the other engines don't pay for its kernel,
+    // convolvers and threads. Message thread only; the spec is the last prepareToPlay()'s.
+    juce::dsp::ProcessSpec linearPhaseSpec {};
+    bool linearPhaseIsPrepared = false;
+    
+    void prepareLinearPhase(const float* gainsInDecibels);
+    
+    // A kernel of a new length reached the audio thread; the host hears about its latency from here
+    void handleAsyncUpdate() override { updateLatency(); }
+    
+    template <typename SampleType>
+    void processLinearPhase(const juce::dsp::AudioBlock<SampleType>& block);
+    void updateLatency();
+    
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+    
+    template <typename SampleType>
+    void processWithActiveEngine(FilterEngines<SampleType>& engines, const juce::dsp::AudioBlock<SampleType>& block);
+    
+    // One task is one lane group of the cascade or the SVFs, or one channel of the parallel form
+    template <typename SampleType>
+    static void processTask(void* processor, int taskIndex);
+    
+    std::atomic<bool> multithreadingEnabled {false};
+    std::unique_ptr<ChannelWorkerPool> workerPool;
+    void updateWorkerPool();
     
     void updatePeakFilters(const ChainSettings& chainSettings);
+    void fetchSettings();
+    void updateChangedPeakFilters();
+    void updateBandCoefficients(int bandIndex, float gainInDecibels);
+    void applyBandCoefficients(int bandIndex, float gainInDecibels, const std::array<double, 6>& coefficients);
+    
+    // A complete set of bands computed away from the audio thread, e.g. when a preset is recalled
+    struct CoefficientBank
+    {
+        double sampleRate = 0.0;
+        std::array<float, numBands> bandGains {};
+        std::array<std::array<double, 6>, numBands> coefficients {};
+    };
+    
+    CoefficientExchange<CoefficientBank> coefficientExchange;
+    
+    void publishPeakFilters(const ChainSettings& chainSettings);
+    void applyPublishedPeakFilters(const CoefficientBank* bank);
+    
+    PresetBank presetBank {apvts.getParameter(Bands::names[0])->getNormalisableRange()};
+    std::atomic<int> currentProgram {0};
+    
+    void setBandGains(const std::array<float, numBands>& gains);
+    void loadState(const PluginState& state);
+    
+    // Gain smoothing, see setSmoothingInterval()
+    static constexpr double smoothingTimeSeconds = 0.05;
+    std::atomic<int> smoothingInterval {0};
+    int samplesUntilSmoothingUpdate = 0; // audio thread only
+    std::array<juce::SmoothedValue<float>, numBands> smoothedBandGains;
+    
+    void updateSmoothedPeakFilters(int rampLength);
+    
+    // Dynamic bands: their detectors run on the input of every sub-block before it's filtered, and their
+    // gains follow on this grid of samples (or the smoothing grid, if that's set)
+    static constexpr int dynamicsInterval = 32;
+    
+    // How far above the threshold a band's level has to be for it to reach its full gain
+    static constexpr float dynamicsRangeDecibels = 6.0f;
+    
+    BandDetector bandDetector;
+    bool anyBandDynamic = false; // audio thread only
+    
+    // The gains the filters are heading for: the fetched gains, with the dynamic bands scaled by their levels
+    std::array<float, numBands> targetBandGains {};
+    
+    void updateTargetGains();
+    
+    template <typename SampleType>
+    void processSmoothed(FilterEngines<SampleType>& engines, const juce::dsp::AudioBlock<SampleType>& block, int interval);
+    
+    // Silence detection: about -120 dBFS, both for the input and for how far the filters have to ring out
+    static constexpr double silenceThreshold = 1.0e-6;
+    juce::int64 silentSamples = 0;      // audio thread only
+    juce::int64 tailLengthSamples = 0;  // audio thread only
+    std::atomic<bool> tailLengthNeedsUpdate {true}; // also set from the message thread
+    bool isIdle = false;
+    std::atomic<double> tailLengthSeconds {0.0};
+    
+    template <typename SampleType>
+    static bool isSilent(const juce::AudioBuffer<SampleType>& buffer, int numChannels);
+    static double getDecaySamples(double a1, double a2);
+    void updateTailLength();
+    
+    // Every coefficient set for the current sample rate, shared with every other instance running at it.
+    // Picked up in prepareToPlay; the audio thread only reads through it.
+    PeakCoefficientTable::Ptr coefficientTable;
+    
+    // Cached so the audio thread doesn't have to look parameters up by name on every block
+    std::array<std::atomic<float>*, numBands> bandGainValues;
+    std::array<juce::RangedAudioParameter*, numBands> bandParameters;
+    std::array<std::atomic<float>*, numBands> bandDynamicValues, bandThresholdValues;
+    std::atomic<float>* dynamicAttackValue = nullptr;
+    std::atomic<float>* dynamicReleaseValue = nullptr;
+    
+    // The parameters as read at the start of the current block, audio thread only
+    ChainSettings fetchedSettings;
+    
+    ProcessingStats processingStats;
+    AnalyserTap analyserTap;
     
-    using Coefficients = Filter::CoefficientsPtr;
-    static void updateCoefficients(Filter::CoefficientsPtr& old, const Coefficients& replacements);
-    static void updateChainCoefficients(MonoChain& monoChain, std::vector<Coefficients>& bandCoefficients);
+    // Snapshot of what the filters were last computed from, so unchanged bands can be skipped
+    std::array<float, numBands> appliedBandGains {};
+    double appliedSampleRate = 0.0;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GraphicEQAudioProcessor)
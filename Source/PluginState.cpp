@@ -0,0 +1,133 @@
+/*
+  ==============================================================================
+
+    Everything an instance saves, and the compact binary format it's saved in.
+
+  ==============================================================================
+*/
+
+#include "PluginState.h"
+
+namespace
+{
+    constexpr char magic[4] = { 'G', 'E', 'Q', 'S' };
+    
+    // Everything before the gains
+    constexpr int headerSize = 4 + 2 + 2 + 1 + 1 + 2 + 4 + 4;
+    
+    static_assert(PresetBank::numPresets <= 16, "The used presets have to fit a uint16");
+    static_assert(Bands::numBands <= 32, "The dynamic bands have to fit a uint32");
+}
+
+bool PluginState::hasMagic(const void* data, int sizeInBytes)
+{
+    return data != nullptr && sizeInBytes >= (int) sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+void PluginState::writeTo(juce::MemoryBlock& destData) const
+{
+    juce::MemoryOutputStream stream(destData, false);
+    
+    stream.write(magic, sizeof(magic));
+    stream.writeShort((short) currentVersion);
+    stream.writeShort((short) numBands);
+    stream.writeByte((char) filterEngine);
+    stream.writeByte((char) (multithreading ? 1 : 0));
+    stream.writeShort((short) currentPreset);
+    stream.writeInt(smoothingInterval);
+    stream.writeInt(linearPhaseKernelLength);
+    
+    for (auto const gain : bandGains)
+        stream.writeFloat(gain);
+    
+    int usedPresets = 0;
+    
+    for (int i = 0; i < PresetBank::numPresets; ++i)
+        if (presetIsUsed[(size_t) i])
+            usedPresets |= 1 << i;
+    
+    stream.writeShort((short) usedPresets);
+    
+    for (int i = 0; i < PresetBank::numPresets; ++i)
+        if (presetIsUsed[(size_t) i])
+            for (auto const gain : presetGains[(size_t) i])
+                stream.writeFloat(gain);
+    
+    juce::uint32 dynamicBands = 0;
+    
+    for (int i = 0; i < numBands; ++i)
+        if (bandDynamic[(size_t) i])
+            dynamicBands |= 1u << i;
+    
+    stream.writeInt((int) dynamicBands);
+    
+    for (auto const threshold : bandThresholds)
+        stream.writeFloat(threshold);
+    
+    stream.writeFloat(dynamicAttackMs);
+    stream.writeFloat(dynamicReleaseMs);
+}
+
+bool PluginState::readFrom(const void* data, int sizeInBytes)
+{
+    if (! hasMagic(data, sizeInBytes) || sizeInBytes < headerSize + numBands * (int) sizeof(float))
+        return false;
+    
+    juce::MemoryInputStream stream(data, (size_t) sizeInBytes, false);
+    stream.skipNextBytes(sizeof(magic));
+    
+    auto const version = (int) (juce::uint16) stream.readShort();
+    
+    if (version < 1 || (int) (juce::uint16) stream.readShort() != numBands)
+        return false;
+    
+    filterEngine = (int) (juce::uint8) stream.readByte();
+    multithreading = (stream.readByte() & 1) != 0;
+    currentPreset = (int) (juce::uint16) stream.readShort();
+    smoothingInterval = stream.readInt();
+    linearPhaseKernelLength = stream.readInt();
+    
+    for (auto& gain : bandGains)
+        gain = stream.readFloat();
+    
+    presetIsUsed.fill(false);
+    hasDynamics = false;
+    
+    // A preset bank that got cut off is dropped as a whole, the bands above still load
+    if (stream.getNumBytesRemaining() < 2)
+        return true;
+    
+    auto const usedPresets = (int) (juce::uint16) stream.readShort();
+    auto const numUsed = juce::countNumberOfBits((juce::uint32) usedPresets);
+    
+    if (stream.getNumBytesRemaining() < (juce::int64) numUsed * numBands * (juce::int64) sizeof(float))
+        return true;
+    
+    for (int i = 0; i < PresetBank::numPresets; ++i) {
+        if ((usedPresets & (1 << i)) == 0)
+            continue;
+        
+        presetIsUsed[(size_t) i] = true;
+        
+        for (auto& gain : presetGains[(size_t) i])
+            gain = stream.readFloat();
+    }
+    
+    if (version < 2 || stream.getNumBytesRemaining() < (juce::int64) (4 + (numBands + 2) * sizeof(float)))
+        return true;
+    
+    auto const dynamicBands = (juce::uint32) stream.readInt();
+    
+    for (int i = 0; i < numBands; ++i)
+        bandDynamic[(size_t) i] = (dynamicBands & (1u << i)) != 0;
+    
+    for (auto& threshold : bandThresholds)
+        threshold = stream.readFloat();
+    
+    dynamicAttackMs = stream.readFloat();
+    dynamicReleaseMs = stream.readFloat();
+    hasDynamics = true;
+    
+    // Anything after this was appended by a later version
+    return true;
+}
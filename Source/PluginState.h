@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    Everything an instance saves, and the compact binary format it's saved in.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandLayout.h"
+#include "PresetBank.h"
+
+/**
+    Little-endian throughout:
+    
+        char[4]     magic, "GEQS"
+        uint16      version
+        uint16      number of bands; a state only loads into the layout it was saved from
+        uint8       filter engine
+        uint8       flags, bit 0: multithreading
+        uint16      current preset
+        int32       smoothing interval
+        int32       linear phase kernel length
+        float32     gain in dB, per band
+        uint16      which presets are used, one bit each
+        float32     gain in dB, per band of each used preset, in preset order
+    
+    Version 2 appends the dynamic EQ:
+    
+        uint32      which bands are dynamic, one bit each
+        float32     threshold in dBFS, per band
+        float32     attack in ms
+        float32     release in ms
+    
+    About 130 bytes for twelve bands and an empty preset bank, against more
+    than a kilobyte for the same ValueTree with its property names, and no tree
+    to build when it's read. Later versions only ever append fields, so older builds can
+    still read what they know of a newer state.
+*/
+struct PluginState
+{
+    static constexpr int currentVersion = 2;
+    static constexpr int numBands = Bands::numBands;
+    
+    std::array<float, numBands> bandGains {};
+    int filterEngine = 0;
+    bool multithreading = false;
+    int smoothingInterval = 0;
+    int linearPhaseKernelLength = 0;
+    int currentPreset = 0;
+    std::array<bool, PresetBank::numPresets> presetIsUsed {};
+    std::array<PresetBank::Gains, PresetBank::numPresets> presetGains {};
+    
+    // Only read from version 2 on; older states leave the dynamic EQ at its defaults
+    bool hasDynamics = false;
+    std::array<bool, numBands> bandDynamic {};
+    std::array<float, numBands> bandThresholds {};
+    float dynamicAttackMs = 0.0f;
+    float dynamicReleaseMs = 0.0f;
+    
+    void writeTo(juce::MemoryBlock& destData) const;
+    
+    // False if the data isn't in this format at all, e.g. an older ValueTree state,
+    // or it's truncated or was saved from a different band layout
+    bool readFrom(const void* data, int sizeInBytes);
+    
+    static bool hasMagic(const void* data, int sizeInBytes);
+};
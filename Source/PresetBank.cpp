@@ -0,0 +1,108 @@
+/*
+  ==============================================================================
+
+    In-memory bank of band gain presets, each with its coefficients computed
+    ahead of time for the current sample rate.
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+
+PresetBank::PresetBank(const juce::NormalisableRange<float>& range)
+    : gainRange(range)
+{
+}
+
+void PresetBank::store(int index, const Gains& gains)
+{
+    const juce::ScopedLock sl(lock);
+    
+    auto& preset = presets[(size_t) index];
+    preset.isUsed = true;
+    preset.gains = gains;
+    updateCoefficients(preset);
+}
+
+void PresetBank::clear(int index)
+{
+    const juce::ScopedLock sl(lock);
+    presets[(size_t) index] = {};
+}
+
+bool PresetBank::isUsed(int index) const
+{
+    const juce::ScopedLock sl(lock);
+    return presets[(size_t) index].isUsed;
+}
+
+bool PresetBank::getGains(int index, Gains& gains) const
+{
+    const juce::ScopedLock sl(lock);
+    auto const& preset = presets[(size_t) index];
+    
+    if (! preset.isUsed)
+        return false;
+    
+    gains = preset.gains;
+    return true;
+}
+
+void PresetBank::setCoefficientTable(PeakCoefficientTable::Ptr newTable)
+{
+    const juce::ScopedLock sl(lock);
+    
+    if (newTable == table)
+        return;
+    
+    table = std::move(newTable);
+    
+    for (auto& preset : presets)
+        if (preset.isUsed)
+            updateCoefficients(preset);
+}
+
+bool PresetBank::getMorph(int a, int b, float amount, Gains& gains, Coefficients& coefficients, double& sampleRate) const
+{
+    const juce::ScopedLock sl(lock);
+    
+    auto const& from = presets[(size_t) a];
+    auto const& to = presets[(size_t) b];
+    
+    if (! from.isUsed || ! to.isUsed)
+        return false;
+    
+    amount = juce::jlimit(0.0f, 1.0f, amount);
+    
+    for (int i = 0; i < numBands; ++i)
+        gains[i] = gainRange.snapToLegalValue(from.gains[i] + amount * (to.gains[i] - from.gains[i]));
+    
+    // Before the processor is prepared the gains are all there is
+    if (table == nullptr) {
+        sampleRate = 0.0;
+        return true;
+    }
+    
+    for (int i = 0; i < numBands; ++i) {
+        auto const gain = gains[i];
+        
+        if (gain == from.gains[i])
+            coefficients[i] = from.coefficients[i];
+        else if (gain == to.gains[i])
+            coefficients[i] = to.coefficients[i];
+        else
+            coefficients[i] = table->getCoefficients(i, gain);
+    }
+    
+    sampleRate = table->getSampleRate();
+    return true;
+}
+
+void PresetBank::updateCoefficients(Preset& preset) const
+{
+    if (table == nullptr)
+        return;
+    
+    for (int i = 0; i < numBands; ++i)
+        preset.coefficients[i] = table->getCoefficients(i, preset.gains[i]);
+}
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    In-memory bank of band gain presets, each with its coefficients computed
+    ahead of time for the current sample rate.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandLayout.h"
+#include "PeakCoefficientTable.h"
+
+/**
+    Exposed to the host as the plugin's programs, so a scene change is a program
+    change. Storing a preset, or a new sample rate, looks its coefficients up
+    once; recalling one, or morphing between two, then only has to hand finished
+    arrays to the audio thread.
+    
+    Morphs move every band's gain linearly from one preset to the other, snapped
+    to the parameters' steps like any other gain, so every coefficient set comes
+    straight from the table or from one of the two presets.
+    
+    Any thread but the audio thread; a lock keeps the editor, the host and
+    prepareToPlay() from tripping over each other.
+*/
+class PresetBank
+{
+public:
+    static constexpr int numBands = Bands::numBands;
+    static constexpr int numPresets = 16;
+    
+    using Gains = std::array<float, numBands>;
+    using Coefficients = std::array<PeakCoefficientTable::CoefficientArray, numBands>;
+    
+    explicit PresetBank(const juce::NormalisableRange<float>& gainRange);
+    
+    void store(int index, const Gains& gains);
+    void clear(int index);
+    bool isUsed(int index) const;
+    bool getGains(int index, Gains& gains) const;
+    
+    // Call whenever the processor picks up a table for a new sample rate
+    void setCoefficientTable(PeakCoefficientTable::Ptr newTable);
+    
+    // Gains and coefficients amount of the way from preset a to preset b, and the sample rate the
+    // coefficients are for: 0 if there's no table yet, and only the gains are filled in. False if
+    // either preset is empty.
+    bool getMorph(int a, int b, float amount, Gains& gains, Coefficients& coefficients, double& sampleRate) const;
+
+private:
+    struct Preset
+    {
+        bool isUsed = false;
+        Gains gains {};
+        Coefficients coefficients {};
+    };
+    
+    void updateCoefficients(Preset& preset) const;
+    
+    juce::NormalisableRange<float> const gainRange;
+    
+    juce::CriticalSection lock;
+    std::array<Preset, numPresets> presets;
+    PeakCoefficientTable::Ptr table;
+    
+    JUCE_DECLARE_NON_COPYABLE (PresetBank)
+};
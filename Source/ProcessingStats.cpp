@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    Per-instance audio thread instrumentation: where processBlock() spends its
+    time, how close it runs to the deadline, and anything it shouldn't do.
+
+  ==============================================================================
+*/
+
+#include "ProcessingStats.h"
+#include "AllocationGuard.h"
+
+namespace
+{
+    double ticksToMicroseconds(double ticks)
+    {
+        return 1.0e6 * ticks / (double) juce::Time::getHighResolutionTicksPerSecond();
+    }
+    
+    char const* const phaseNames[] {"parameterFetch", "coefficientUpdate", "filtering"};
+}
+
+void ProcessingStats::prepare(double sampleRate) noexcept
+{
+    ticksPerSample = (double) juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+    blockPhaseTicks = {};
+}
+
+void ProcessingStats::beginBlock() noexcept
+{
+    if (resetRequested.exchange(false))
+        clear();
+    
+    blockStartTicks = juce::Time::getHighResolutionTicks();
+}
+
+void ProcessingStats::endBlock(int numSamples, bool skipped, juce::uint64 blockAllocations, juce::uint64 blockLocks) noexcept
+{
+    auto const ticks = juce::jmax((juce::int64) 0, juce::Time::getHighResolutionTicks() - blockStartTicks);
+    auto const deadline = juce::jmax(1.0, numSamples * ticksPerSample);
+    auto const load = (double) ticks / deadline;
+    
+    // Filtering is whatever the timed phases left over
+    auto& filtering = blockPhaseTicks[(size_t) Phase::filtering];
+    filtering = juce::jmax((juce::int64) 0, ticks - blockPhaseTicks[(size_t) Phase::parameterFetch] - blockPhaseTicks[(size_t) Phase::coefficientUpdate]);
+    
+    for (int phase = 0; phase < numPhases; ++phase)
+        add(phaseTicks[(size_t) phase], (juce::uint64) blockPhaseTicks[(size_t) phase]);
+    
+    int bin = 0;
+    
+    while (bin < (int) histogramEdges.size() && load >= histogramEdges[(size_t) bin])
+        ++bin;
+    
+    add(histogram[(size_t) bin], 1);
+    add(blocks, 1);
+    add(totalTicks, (juce::uint64) ticks);
+    add(deadlineTicks, (juce::uint64) deadline);
+    add(coefficientUpdates, blockCoefficientUpdates);
+    add(parallelFormUpdates, blockParallelFormUpdates);
+    add(allocations, blockAllocations);
+    add(locks, blockLocks);
+    
+    if (skipped)
+        add(skippedBlocks, 1);
+    
+    if (load > 1.0)
+        add(overruns, 1);
+    
+    if ((juce::uint64) ticks > maxBlockTicks.load(std::memory_order_relaxed))
+        maxBlockTicks.store((juce::uint64) ticks, std::memory_order_relaxed);
+    
+    if (load > peakLoad.load(std::memory_order_relaxed))
+        peakLoad.store(load, std::memory_order_relaxed);
+    
+    blockPhaseTicks = {};
+    blockCoefficientUpdates = blockParallelFormUpdates = 0;
+}
+
+void ProcessingStats::clear() noexcept
+{
+    for (auto* counter : { &blocks, &skippedBlocks, &overruns, &coefficientUpdates, &parallelFormUpdates,
+                           &allocations, &locks, &totalTicks, &maxBlockTicks, &deadlineTicks })
+        counter->store(0, std::memory_order_relaxed);
+    
+    for (auto& counter : phaseTicks)
+        counter.store(0, std::memory_order_relaxed);
+    
+    for (auto& counter : histogram)
+        counter.store(0, std::memory_order_relaxed);
+    
+    peakLoad.store(0.0, std::memory_order_relaxed);
+}
+
+ProcessingStats::Snapshot ProcessingStats::getSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.blocks = blocks.load(std::memory_order_relaxed);
+    snapshot.skippedBlocks = skippedBlocks.load(std::memory_order_relaxed);
+    snapshot.overruns = overruns.load(std::memory_order_relaxed);
+    snapshot.coefficientUpdates = coefficientUpdates.load(std::memory_order_relaxed);
+    snapshot.parallelFormUpdates = parallelFormUpdates.load(std::memory_order_relaxed);
+    snapshot.allocations = allocations.load(std::memory_order_relaxed);
+    snapshot.locks = locks.load(std::memory_order_relaxed);
+    snapshot.allocationsTracked = ScopedAllocationCounter::isAvailable();
+    
+    auto const numBlocks = (double) juce::jmax((juce::uint64) 1, snapshot.blocks);
+    auto const ticks = (double) totalTicks.load(std::memory_order_relaxed);
+    
+    snapshot.averageLoad = ticks / juce::jmax(1.0, (double) deadlineTicks.load(std::memory_order_relaxed));
+    snapshot.peakLoad = peakLoad.load(std::memory_order_relaxed);
+    snapshot.averageBlockMicroseconds = ticksToMicroseconds(ticks / numBlocks);
+    snapshot.maxBlockMicroseconds = ticksToMicroseconds((double) maxBlockTicks.load(std::memory_order_relaxed));
+    
+    for (int phase = 0; phase < numPhases; ++phase)
+        snapshot.averagePhaseMicroseconds[(size_t) phase] = ticksToMicroseconds((double) phaseTicks[(size_t) phase].load(std::memory_order_relaxed) / numBlocks);
+    
+    for (int bin = 0; bin < numHistogramBins; ++bin)
+        snapshot.histogram[(size_t) bin] = histogram[(size_t) bin].load(std::memory_order_relaxed);
+    
+    return snapshot;
+}
+
+juce::String ProcessingStats::Snapshot::getHistogramBinName(int bin)
+{
+    if (bin >= (int) histogramEdges.size())
+        return ">=100%";
+    
+    return "<" + juce::String(100.0 * histogramEdges[(size_t) bin], 1) + "%";
+}
+
+juce::String ProcessingStats::Snapshot::toText() const
+{
+    juce::String text;
+    
+    text << "blocks: " << juce::String(blocks) << " (" << juce::String(skippedBlocks) << " skipped as silent)\n"
+         << "load: " << juce::String(100.0 * averageLoad, 2) << "% average, " << juce::String(100.0 * peakLoad, 2) << "% peak, "
+         << juce::String(overruns) << " overruns\n"
+         << "block time: " << juce::String(averageBlockMicroseconds, 2) << " us average, " << juce::String(maxBlockMicroseconds, 2) << " us max\n";
+    
+    for (int phase = 0; phase < numPhases; ++phase)
+        text << "  " << phaseNames[phase] << ": " << juce::String(averagePhaseMicroseconds[(size_t) phase], 2) << " us average\n";
+    
+    text << "deadline used:";
+    
+    for (int bin = 0; bin < numHistogramBins; ++bin)
+        text << " " << getHistogramBinName(bin) << " " << juce::String(histogram[(size_t) bin]);
+    
+    text << "\ncoefficient updates: " << juce::String(coefficientUpdates) << " bands, " << juce::String(parallelFormUpdates) << " parallel forms\n"
+         << "allocations: " << (allocationsTracked ? juce::String(allocations) : juce::String("not tracked in this build")) << "\n"
+         << "locks: " << juce::String(locks) << "\n";
+    
+    return text;
+}
+
+juce::String ProcessingStats::Snapshot::toJSON() const
+{
+    auto* phases = new juce::DynamicObject();
+    
+    for (int phase = 0; phase < numPhases; ++phase)
+        phases->setProperty(phaseNames[phase], averagePhaseMicroseconds[(size_t) phase]);
+    
+    auto* bins = new juce::DynamicObject();
+    
+    for (int bin = 0; bin < numHistogramBins; ++bin)
+        bins->setProperty(getHistogramBinName(bin), (juce::int64) histogram[(size_t) bin]);
+    
+    auto* root = new juce::DynamicObject();
+    root->setProperty("blocks", (juce::int64) blocks);
+    root->setProperty("skippedBlocks", (juce::int64) skippedBlocks);
+    root->setProperty("overruns", (juce::int64) overruns);
+    root->setProperty("averageLoad", averageLoad);
+    root->setProperty("peakLoad", peakLoad);
+    root->setProperty("averageBlockMicroseconds", averageBlockMicroseconds);
+    root->setProperty("maxBlockMicroseconds", maxBlockMicroseconds);
+    root->setProperty("averagePhaseMicroseconds", juce::var(phases));
+    root->setProperty("deadlineHistogram", juce::var(bins));
+    root->setProperty("coefficientUpdates", (juce::int64) coefficientUpdates);
+    root->setProperty("parallelFormUpdates", (juce::int64) parallelFormUpdates);
+    root->setProperty("allocations", allocationsTracked ? juce::var((juce::int64) allocations) : juce::var());
+    root->setProperty("locks", (juce::int64) locks);
+    
+    return juce::JSON::toString(juce::var(root));
+}
@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    Per-instance audio thread instrumentation: where processBlock() spends its
+    time, how close it runs to the deadline, and anything it shouldn't do.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Written by the audio thread only, read from any thread. Every counter is an
+    atomic with a single writer, so the audio thread updates them with plain
+    relaxed loads and stores: no read-modify-write, no lock, nothing that can
+    wait. Readers may see one counter a block ahead of another, never a torn value.
+    
+    A block costs two timer reads, two more per timed phase, and a handful of
+    stores, so this stays compiled into release builds.
+    
+    Filtering time isn't timed separately, it's whatever of the block the other
+    phases didn't take. The histogram sorts blocks by how much of their deadline
+    (their length in real time) they used, with the last bin counting overruns.
+    
+    Allocations are only seen where the replacement operator new is compiled in
+    (see ScopedAllocationCounter), Snapshot::allocationsTracked says whether it is.
+*/
+class ProcessingStats
+{
+public:
+    enum class Phase
+    {
+        parameterFetch,    // picking up published banks and reading the parameters
+        coefficientUpdate, // recomputing and ramping band coefficients
+        filtering,
+        numPhases
+    };
+    
+    static constexpr int numPhases = (int) Phase::numPhases;
+    
+    // Upper edges, as fractions of the deadline; one more bin holds everything above the last
+    static constexpr std::array<double, 7> histogramEdges {1.0 / 64, 1.0 / 32, 1.0 / 16, 1.0 / 8, 1.0 / 4, 1.0 / 2, 1.0};
+    static constexpr int numHistogramBins = (int) histogramEdges.size() + 1;
+    
+    struct Snapshot
+    {
+        juce::uint64 blocks = 0, skippedBlocks = 0, overruns = 0;
+        juce::uint64 coefficientUpdates = 0, parallelFormUpdates = 0;
+        juce::uint64 allocations = 0, locks = 0;
+        bool allocationsTracked = false;
+        
+        double averageLoad = 0.0, peakLoad = 0.0; // block time over deadline
+        double averageBlockMicroseconds = 0.0, maxBlockMicroseconds = 0.0;
+        std::array<double, numPhases> averagePhaseMicroseconds {};
+        std::array<juce::uint64, numHistogramBins> histogram {};
+        
+        juce::String toText() const;
+        juce::String toJSON() const;
+        
+        static juce::String getHistogramBinName(int bin);
+    };
+    
+    // Any thread
+    Snapshot getSnapshot() const;
+    juce::uint64 getNumSkippedBlocks() const noexcept { return skippedBlocks.load(std::memory_order_relaxed); }
+    
+    // Any thread; the audio thread clears everything at the start of its next block
+    void reset() noexcept { resetRequested = true; }
+    
+    // Call from prepareToPlay()
+    void prepare(double sampleRate) noexcept;
+    
+    //==============================================================================
+    // Audio thread only, and prepareToPlay() for the counts
+    void beginBlock() noexcept;
+    void endBlock(int numSamples, bool skipped, juce::uint64 allocations, juce::uint64 locks) noexcept;
+    
+    void addPhaseTicks(Phase phase, juce::int64 ticks) noexcept { blockPhaseTicks[(size_t) phase] += ticks; }
+    void countCoefficientUpdate() noexcept { ++blockCoefficientUpdates; }
+    void countParallelFormUpdate() noexcept { ++blockParallelFormUpdates; }
+    
+    // Times the scope into one phase of the current block
+    struct ScopedPhase
+    {
+        ScopedPhase(ProcessingStats& s, Phase p) noexcept : stats(s), phase(p), start(juce::Time::getHighResolutionTicks()) {}
+        ~ScopedPhase() noexcept { stats.addPhaseTicks(phase, juce::Time::getHighResolutionTicks() - start); }
+        
+        ProcessingStats& stats;
+        Phase const phase;
+        juce::int64 const start;
+        
+        JUCE_DECLARE_NON_COPYABLE (ScopedPhase)
+    };
+
+private:
+    using Counter = std::atomic<juce::uint64>;
+    
+    // Single writer, so a load and a store do what fetch_add would, without the locked instruction
+    static void add(Counter& counter, juce::uint64 amount) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    
+    void clear() noexcept;
+    
+    double ticksPerSample = 0.0;
+    
+    // Audio thread only: the block in progress
+    juce::int64 blockStartTicks = 0;
+    std::array<juce::int64, numPhases> blockPhaseTicks {};
+    juce::uint64 blockCoefficientUpdates = 0, blockParallelFormUpdates = 0;
+    
+    std::atomic<bool> resetRequested {false};
+    
+    Counter blocks {0}, skippedBlocks {0}, overruns {0};
+    Counter coefficientUpdates {0}, parallelFormUpdates {0};
+    Counter allocations {0}, locks {0};
+    Counter totalTicks {0}, maxBlockTicks {0}, deadlineTicks {0};
+    std::array<Counter, numPhases> phaseTicks {};
+    std::array<Counter, numHistogramBins> histogram {};
+    std::atomic<double> peakLoad {0.0};
+};
@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+    The combined magnitude response of every band, evaluated on a background
+    thread and handed to the editor as a ready-to-fill path.
+
+  ==============================================================================
+*/
+
+#include "ResponseCurve.h"
+
+double ResponseCurve::getFrequencyAt(double x)
+{
+    auto const position = x * numBands - 0.5;
+    auto const segment = juce::jlimit(0, numBands - 2, (int) std::floor(position));
+    auto const low = (double) Bands::freqs[(size_t) segment], high = (double) Bands::freqs[(size_t) segment + 1];
+    
+    return low * std::pow(high / low, position - segment);
+}
+
+ResponseCurve::ResponseCurve(const juce::NormalisableRange<float>& range)
+    : juce::Thread("Response curve"), gainRange(range)
+{
+    startThread();
+}
+
+ResponseCurve::~ResponseCurve()
+{
+    stopThread(1000);
+}
+
+void ResponseCurve::update(double sampleRate, const std::array<float, numBands>& bandGains, juce::Rectangle<float> area)
+{
+    {
+        const juce::SpinLock::ScopedLockType sl(requestLock);
+        
+        if (sampleRate == request.sampleRate && bandGains == request.bandGains && area == request.area)
+            return;
+        
+        request.sampleRate = sampleRate;
+        request.bandGains = bandGains;
+        request.area = area;
+    }
+    
+    notify();
+}
+
+void ResponseCurve::run()
+{
+    while (! threadShouldExit()) {
+        Request latest;
+        
+        {
+            const juce::SpinLock::ScopedLockType sl(requestLock);
+            latest = request;
+        }
+        
+        if (latest.sampleRate > 0.0 && ! latest.area.isEmpty()) {
+            bool const sampleRateChanged = latest.sampleRate != computed.sampleRate;
+            bool bandsChanged = false;
+            
+            if (sampleRateChanged)
+                prepare(latest.sampleRate);
+            
+            // Only bands whose gain moved are evaluated again
+            for (int i = 0; i < numBands; ++i) {
+                if (sampleRateChanged || latest.bandGains[(size_t) i] != computed.bandGains[(size_t) i]) {
+                    evaluateBand(i, latest.bandGains[(size_t) i]);
+                    bandsChanged = true;
+                }
+            }
+            
+            if (bandsChanged) {
+                for (int group = 0; group < numGroups; ++group) {
+                    auto numerator = Vec::expand(1.0), denominator = Vec::expand(1.0);
+                    
+                    for (int i = 0; i < numBands; ++i) {
+                        numerator *= numerators[(size_t) i][(size_t) group];
+                        denominator *= denominators[(size_t) i][(size_t) group];
+                    }
+                    
+                    numeratorProduct[(size_t) group] = numerator;
+                    denominatorProduct[(size_t) group] = denominator;
+                }
+            }
+            
+            if (bandsChanged || latest.area != computed.area) {
+                buildOutline(latest.area);
+                curves.publish([this](Curve& published) { published.outline.swapWithPath(outline); });
+            }
+            
+            computed = latest;
+        }
+        
+        // Whatever update() posted while this pass ran has already notified, so this returns straight away
+        wait(-1);
+    }
+}
+
+void ResponseCurve::prepare(double sampleRate)
+{
+    coefficientTable = PeakCoefficientTable::getShared(sampleRate, Bands::freqs.data(), Bands::qualities.data(), numBands, gainRange);
+    
+    phis.resize((size_t) numGroups);
+    numeratorProduct.resize((size_t) numGroups);
+    denominatorProduct.resize((size_t) numGroups);
+    
+    for (int i = 0; i < numBands; ++i) {
+        numerators[(size_t) i].resize((size_t) numGroups);
+        denominators[(size_t) i].resize((size_t) numGroups);
+    }
+    
+    alignas(Vec) double lanes[lanesPerGroup];
+    
+    for (int group = 0; group < numGroups; ++group) {
+        for (int lane = 0; lane < lanesPerGroup; ++lane) {
+            auto const point = group * lanesPerGroup + lane;
+            auto const frequency = juce::jlimit(1.0, 0.49 * sampleRate, getFrequencyAt((double) point / (numPoints - 1)));
+            auto const halfOmega = juce::MathConstants<double>::pi * frequency / sampleRate;
+            
+            lanes[lane] = std::sin(halfOmega) * std::sin(halfOmega);
+        }
+        
+        phis[(size_t) group] = Vec::fromRawArray(lanes);
+    }
+}
+
+void ResponseCurve::evaluateBand(int bandIndex, float gainInDecibels)
+{
+    // Normalised, so a0 is 1
+    auto const c = coefficientTable->getCoefficients(bandIndex, gainInDecibels);
+    auto const numeratorTerms = PeakCoefficientTable::getSquaredMagnitudeTerms(c[0], c[1], c[2]);
+    auto const denominatorTerms = PeakCoefficientTable::getSquaredMagnitudeTerms(c[3], c[4], c[5]);
+    
+    auto const n0 = Vec::expand(numeratorTerms[0]), n1 = Vec::expand(numeratorTerms[1]), n2 = Vec::expand(numeratorTerms[2]);
+    auto const d0 = Vec::expand(denominatorTerms[0]), d1 = Vec::expand(denominatorTerms[1]), d2 = Vec::expand(denominatorTerms[2]);
+    
+    auto* numerator = numerators[(size_t) bandIndex].data();
+    auto* denominator = denominators[(size_t) bandIndex].data();
+    
+    for (int group = 0; group < numGroups; ++group) {
+        auto const phi = phis[(size_t) group];
+        
+        numerator[group] = n0 + phi * (n1 + phi * n2);
+        denominator[group] = d0 + phi * (d1 + phi * d2);
+    }
+}
+
+void ResponseCurve::buildOutline(juce::Rectangle<float> area)
+{
+    alignas(Vec) double numerator[lanesPerGroup], denominator[lanesPerGroup];
+    
+    curve.clear();
+    
+    for (int group = 0; group < numGroups; ++group) {
+        numeratorProduct[(size_t) group].copyToRawArray(numerator);
+        denominatorProduct[(size_t) group].copyToRawArray(denominator);
+        
+        for (int lane = 0; lane < lanesPerGroup; ++lane) {
+            auto const point = group * lanesPerGroup + lane;
+            auto const squaredMagnitude = juce::jmax(1.0e-12, numerator[lane] / denominator[lane]);
+            auto const decibels = juce::jlimit(gainRange.start, gainRange.end, (float) (10.0 * std::log10(squaredMagnitude)));
+            
+            auto const x = area.getX() + area.getWidth() * (float) point / (numPoints - 1);
+            auto const y = juce::jmap(decibels, gainRange.start, gainRange.end, area.getBottom(), area.getY());
+            
+            if (point == 0)
+                curve.startNewSubPath(x, y);
+            else
+                curve.lineTo(x, y);
+        }
+    }
+    
+    outline.clear();
+    juce::PathStrokeType(2.0f, juce::PathStrokeType::curved, juce::PathStrokeType::rounded).createStrokedPath(outline, curve);
+}
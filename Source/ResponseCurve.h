@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    The combined magnitude response of every band, evaluated on a background
+    thread and handed to the editor as a ready-to-fill path.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandLayout.h"
+#include "PeakCoefficientTable.h"
+#include "CoefficientExchange.h"
+
+/**
+    The editor posts the current gains, sample rate and drawing area with update();
+    the worker picks them up, re-evaluates only the bands whose gain changed, and
+    publishes the stroked outline of the curve through the same triple buffer the
+    audio thread gets coefficient banks from. The editor picks the newest one up
+    once per frame, so neither side ever waits for the other.
+    
+    Coefficients come from the shared PeakCoefficientTable, i.e. exactly what the
+    processor runs. Each band's squared magnitude is a ratio of two quadratics in
+    phi = sin^2(w/2) (the form from the RBJ cookbook, which stays accurate for the
+    low bands where the direct form cancels out). Numerators and denominators are
+    evaluated a SIMD register of points at a time and kept per band, so a changed
+    band costs one pass over the points, and the total is two products over the
+    bands plus one logarithm per point.
+    
+    Horizontally the curve follows the sliders rather than a plain log axis: each
+    band's centre frequency lands on its slider, with log-spaced points in between.
+*/
+class ResponseCurve : private juce::Thread
+{
+public:
+    static constexpr int numBands = Bands::numBands;
+    static constexpr int numPoints = 1024;
+    
+    // What the editor draws: the outline of the stroked curve, in the editor's coordinates
+    struct Curve
+    {
+        juce::Path outline;
+    };
+    
+    explicit ResponseCurve(const juce::NormalisableRange<float>& gainRange);
+    ~ResponseCurve() override;
+    
+    // Message thread. The curve spans the area horizontally, and the gain range vertically.
+    void update(double sampleRate, const std::array<float, numBands>& bandGains, juce::Rectangle<float> area);
+    
+    // Message thread. The newest curve if one was published since the last call, otherwise nullptr;
+    // a curve stays valid until the next call.
+    const Curve* pickUpLatest() noexcept { return curves.pickUpLatest(); }
+    
+    // The editor's horizontal axis: position across the sliders (0 to 1) to frequency. Band centres sit
+    // under their sliders, log-spaced in between and extrapolated past the outer bands.
+    static double getFrequencyAt(double x);
+
+private:
+    using Vec = juce::dsp::SIMDRegister<double>;
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+    static constexpr int numGroups = numPoints / lanesPerGroup;
+    
+    struct Request
+    {
+        double sampleRate = 0.0;
+        std::array<float, numBands> bandGains {};
+        juce::Rectangle<float> area;
+    };
+    
+    void run() override;
+    
+    void prepare(double sampleRate);
+    void evaluateBand(int bandIndex, float gainInDecibels);
+    void buildOutline(juce::Rectangle<float> area);
+    
+    juce::NormalisableRange<float> const gainRange;
+    
+    // Written by update(), copied out by the worker
+    juce::SpinLock requestLock;
+    Request request;
+    
+    // Worker only
+    Request computed;
+    PeakCoefficientTable::Ptr coefficientTable;
+    std::vector<Vec> phis;
+    std::array<std::vector<Vec>, numBands> numerators, denominators;
+    std::vector<Vec> numeratorProduct, denominatorProduct;
+    juce::Path curve, outline;
+    
+    CoefficientExchange<Curve> curves;
+    
+    JUCE_DECLARE_NON_COPYABLE (ResponseCurve)
+};
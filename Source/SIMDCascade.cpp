@@ -0,0 +1,336 @@
+/*
+  ==============================================================================
+
+    Biquad cascade that runs every channel of a block through the same sections
+    at once, one channel per SIMD lane.
+
+  ==============================================================================
+*/
+
+#include "SIMDCascade.h"
+
+namespace
+{
+    // About -120 dBFS, well below anything audible once a drained section is dropped
+    constexpr float decayThreshold = 1.0e-6f;
+    
+    template <typename Vec>
+    Vec const zero = Vec::expand(0);
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::prepare(int newNumChannels, int newNumSections)
+{
+    numChannels = newNumChannels;
+    numSections = newNumSections;
+    numGroups = (numChannels + lanesPerGroup - 1) / lanesPerGroup;
+    
+    // Sections default to pass-through until real coefficients arrive
+    coefficients.resize((size_t) numSections, { Vec::expand(1), zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    targets.resize((size_t) numSections, { Vec::expand(1), zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    deltas.resize((size_t) numSections, { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    rampedCoefficients.resize((size_t) (numGroups * numSections));
+    targetIsIdentity.resize((size_t) numSections, 1);
+    states.resize((size_t) (numGroups * numSections));
+    sectionModes.resize((size_t) numSections, SectionMode::bypassed);
+    activeSections.resize((size_t) numSections);
+    
+    reset();
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::reset()
+{
+    for (auto& state : states)
+        state = { zero<Vec>, zero<Vec> };
+    
+    if (isRamping())
+        finishRamp();
+    
+    // Nothing left to ring out once the state is cleared
+    for (auto& mode : sectionModes)
+        if (mode == SectionMode::draining)
+            mode = SectionMode::bypassed;
+    
+    updateActiveSections();
+}
+
+template <typename SampleType>
+typename SIMDCascade<SampleType>::SectionCoefficients SIMDCascade<SampleType>::normalise(const std::array<double, 6>& c) noexcept
+{
+    auto a0Inv = 1.0 / c[3];
+    
+    return { Vec::expand((SampleType) (c[0] * a0Inv)),
+             Vec::expand((SampleType) (c[1] * a0Inv)),
+             Vec::expand((SampleType) (c[2] * a0Inv)),
+             Vec::expand((SampleType) (c[4] * a0Inv)),
+             Vec::expand((SampleType) (c[5] * a0Inv)) };
+}
+
+template <typename SampleType>
+bool SIMDCascade<SampleType>::isIdentity(const std::array<double, 6>& c) noexcept
+{
+    // A peak filter at unity gain has identical numerator and denominator, exactly
+    return c[0] == c[3] && c[1] == c[4] && c[2] == c[5];
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::setCoefficients(int sectionIndex, const std::array<double, 6>& c)
+{
+    jassert(juce::isPositiveAndBelow(sectionIndex, numSections));
+    
+    auto const index = (size_t) sectionIndex;
+    
+    coefficients[index] = targets[index] = normalise(c);
+    deltas[index] = { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> };
+    targetIsIdentity[index] = isIdentity(c);
+    
+    updateSectionMode(sectionIndex, isIdentity(c));
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::rampCoefficients(int sectionIndex, const std::array<double, 6>& c, int rampLength)
+{
+    jassert(juce::isPositiveAndBelow(sectionIndex, numSections));
+    jassert(rampLength > 0);
+    
+    // Sections ramped together share one countdown. Anything still half way through an older ramp
+    // (only when the ramp length changes) jumps to its target first.
+    if (isRamping() && rampSamplesRemaining != rampLength)
+        finishRamp();
+    
+    auto const index = (size_t) sectionIndex;
+    auto const& from = coefficients[index];
+    auto const& to = targets[index] = normalise(c);
+    auto const scale = (SampleType) 1 / (SampleType) rampLength;
+    
+    deltas[index] = { (to.b0 - from.b0) * scale,
+                      (to.b1 - from.b1) * scale,
+                      (to.b2 - from.b2) * scale,
+                      (to.a1 - from.a1) * scale,
+                      (to.a2 - from.a2) * scale };
+    
+    targetIsIdentity[index] = isIdentity(c);
+    rampSamplesRemaining = rampLength;
+    
+    // A section ramping towards flat has to keep running until the ramp is over, finishRamp() deals with it then
+    if (! isIdentity(c))
+        updateSectionMode(sectionIndex, false);
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::updateSectionMode(int sectionIndex, bool identity) noexcept
+{
+    auto& mode = sectionModes[(size_t) sectionIndex];
+    auto const previousMode = mode;
+    
+    if (! identity)
+        mode = SectionMode::active;
+    else if (mode == SectionMode::active)
+        mode = SectionMode::draining;
+    
+    if (mode != previousMode)
+        updateActiveSections();
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::finishRamp() noexcept
+{
+    rampSamplesRemaining = 0;
+    
+    for (int section = 0; section < numSections; ++section) {
+        auto const index = (size_t) section;
+        
+        coefficients[index] = targets[index];
+        deltas[index] = { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> };
+        
+        if (targetIsIdentity[index])
+            updateSectionMode(section, true);
+    }
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block) noexcept
+{
+    // Every section is an identity, so the block already holds the output
+    if (isPassThrough())
+        return;
+    
+    auto const groupsToProcess = getNumGroups(block);
+    
+    for (int group = 0; group < groupsToProcess; ++group)
+        processGroup(block, group);
+    
+    finishBlock((int) block.getNumSamples());
+}
+
+template <typename SampleType>
+int SIMDCascade<SampleType>::getNumGroups(const juce::dsp::AudioBlock<SampleType>& block) const noexcept
+{
+    auto const channelsToProcess = juce::jmin((int) block.getNumChannels(), numChannels);
+    return (channelsToProcess + lanesPerGroup - 1) / lanesPerGroup;
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::processGroup(const juce::dsp::AudioBlock<SampleType>& block, int group) noexcept
+{
+    auto const channelsToProcess = juce::jmin((int) block.getNumChannels(), numChannels);
+    auto const firstChannel = group * lanesPerGroup;
+    auto const numChannelsInGroup = juce::jmin(lanesPerGroup, channelsToProcess - firstChannel);
+    
+    jassert(numChannelsInGroup > 0);
+    
+    SampleType* channels[lanesPerGroup];
+    
+    for (int lane = 0; lane < numChannelsInGroup; ++lane)
+        channels[lane] = block.getChannelPointer((size_t) (firstChannel + lane));
+    
+    auto const numSamples = (int) block.getNumSamples();
+    auto const rampSamples = juce::jmin(numSamples, rampSamplesRemaining);
+    
+    if (rampSamples > 0)
+        processLanes<true>(channels, numChannelsInGroup, 0, rampSamples, group);
+    
+    if (rampSamples < numSamples)
+        processLanes<false>(channels, numChannelsInGroup, rampSamples, numSamples - rampSamples, group);
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::finishBlock(int numSamples) noexcept
+{
+    // Every group ramped its own copy, this moves the shared starting point along to match
+    if (isRamping()) {
+        auto const advanced = juce::jmin(numSamples, rampSamplesRemaining);
+        rampSamplesRemaining -= advanced;
+        
+        if (rampSamplesRemaining == 0) {
+            finishRamp();
+        } else {
+            auto const steps = (SampleType) advanced;
+            
+            for (int section = 0; section < numSections; ++section) {
+                auto& c = coefficients[(size_t) section];
+                auto const& d = deltas[(size_t) section];
+                
+                c = { c.b0 + d.b0 * steps, c.b1 + d.b1 * steps, c.b2 + d.b2 * steps, c.a1 + d.a1 * steps, c.a2 + d.a2 * steps };
+            }
+        }
+    }
+    
+    if (anyDraining)
+        retireDrainedSections();
+}
+
+template <typename SampleType>
+template <bool withRamp>
+void SIMDCascade<SampleType>::processLanes(SampleType* const* channels, int numChannelsInGroup, int startSample, int numSamples, int group) noexcept
+{
+    alignas(Vec) SampleType frame[lanesPerGroup];
+    
+    auto* state = states.data() + group * numSections;
+    auto const* sectionsToRun = activeSections.data();
+    auto const numSectionsToRun = numActiveSections;
+    
+    // Outside a ramp the targets are the coefficients; during one, this group steps its own copy along
+    auto* ramped = rampedCoefficients.data() + group * numSections;
+    auto const* sectionDeltas = deltas.data();
+    auto const* sectionCoefficients = withRamp ? ramped : targets.data();
+    
+    if (withRamp)
+        for (int k = 0; k < numSectionsToRun; ++k)
+            ramped[sectionsToRun[k]] = coefficients[(size_t) sectionsToRun[k]];
+    
+    for (int i = startSample; i < startSample + numSamples; ++i) {
+        // Unused lanes are fed silence so they never carry anything from an earlier, wider layout
+        for (int lane = 0; lane < lanesPerGroup; ++lane)
+            frame[lane] = lane < numChannelsInGroup ? channels[lane][i] : SampleType();
+        
+        auto x = Vec::fromRawArray(frame);
+        
+        for (int k = 0; k < numSectionsToRun; ++k) {
+            auto const section = sectionsToRun[k];
+            auto const& c = sectionCoefficients[section];
+            auto& s = state[section];
+            
+            auto y = c.b0 * x + s.s1;
+            s.s1 = c.b1 * x - c.a1 * y + s.s2;
+            s.s2 = c.b2 * x - c.a2 * y;
+            x = y;
+            
+            if (withRamp) {
+                auto& r = ramped[section];
+                auto const& d = sectionDeltas[section];
+                
+                r.b0 += d.b0;
+                r.b1 += d.b1;
+                r.b2 += d.b2;
+                r.a1 += d.a1;
+                r.a2 += d.a2;
+            }
+        }
+        
+        x.copyToRawArray(frame);
+        
+        for (int lane = 0; lane < numChannelsInGroup; ++lane)
+            channels[lane][i] = frame[lane];
+    }
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::retireDrainedSections() noexcept
+{
+    bool anyRetired = false;
+    
+    for (int section = 0; section < numSections; ++section) {
+        if (sectionModes[(size_t) section] != SectionMode::draining || ! hasDecayed(section))
+            continue;
+        
+        for (int group = 0; group < numGroups; ++group)
+            states[(size_t) (group * numSections + section)] = { zero<Vec>, zero<Vec> };
+        
+        sectionModes[(size_t) section] = SectionMode::bypassed;
+        anyRetired = true;
+    }
+    
+    if (anyRetired)
+        updateActiveSections();
+}
+
+template <typename SampleType>
+void SIMDCascade<SampleType>::updateActiveSections() noexcept
+{
+    numActiveSections = 0;
+    anyDraining = false;
+    
+    for (int section = 0; section < numSections; ++section) {
+        auto const mode = sectionModes[(size_t) section];
+        
+        if (mode != SectionMode::bypassed)
+            activeSections[(size_t) numActiveSections++] = section;
+        
+        anyDraining = anyDraining || mode == SectionMode::draining;
+    }
+}
+
+template <typename SampleType>
+bool SIMDCascade<SampleType>::hasDecayed(int sectionIndex) const noexcept
+{
+    alignas(Vec) SampleType lanes[lanesPerGroup];
+    
+    for (int group = 0; group < numGroups; ++group) {
+        auto const& state = states[(size_t) (group * numSections + sectionIndex)];
+        
+        for (auto const& v : { state.s1, state.s2 }) {
+            Vec::abs(v).copyToRawArray(lanes);
+            
+            for (auto sample : lanes)
+                if (sample > decayThreshold)
+                    return false;
+        }
+    }
+    
+    return true;
+}
+
+template class SIMDCascade<float>;
+template class SIMDCascade<double>;
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    Biquad cascade that runs every channel of a block through the same sections
+    at once, one channel per SIMD lane.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Replaces one ProcessorChain of IIR::Filters per channel. Channels are packed
+    into the lanes of a juce::dsp::SIMDRegister (4 floats on SSE/NEON), so stereo
+    material walks the buffer once instead of twice, and every section of the
+    cascade runs once per sample frame for all channels in the group.
+
+    All channels share one set of coefficients; only the filter state is per lane.
+    Sections are transposed direct form II, like juce::dsp::IIR::Filter.
+
+    Sections whose coefficients are an identity (a peak filter at 0 dB) are left out
+    of the per-sample loop, so the cost scales with the number of bands in use and an
+    all-flat cascade doesn't touch the buffer at all. A section that goes flat keeps
+    running until whatever is left in its state has rung out, so dropping it doesn't
+    click; a section coming back in starts from clear state, which is exactly what an
+    identity section would have contained.
+
+    Templated on the sample type, so double precision buffers run natively as well;
+    a double SIMDRegister holds half as many lanes, so twice as many groups.
+
+    Coefficients can either change in one step, or ramp linearly to a new set over a
+    number of samples. The ramp interpolates the normalised coefficients directly,
+    which is cheap (one add per coefficient per sample) and keeps every section
+    stable: the set of stable (a1, a2) pairs is a triangle, so a straight line between
+    two stable sets never leaves it.
+*/
+template <typename SampleType>
+class SIMDCascade
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    
+    // Allocates the state for the given layout, call from prepareToPlay
+    void prepare(int numChannels, int numSections);
+    void reset();
+    
+    // Takes the ArrayCoefficients layout (b0, b1, b2, a0, a1, a2), in double whatever the sample type
+    void setCoefficients(int sectionIndex, const std::array<double, 6>& coefficients);
+    
+    // Moves linearly from the current coefficients to the new ones over the next rampLength samples.
+    // Sections ramped at the same time share one countdown, so they must use the same length.
+    void rampCoefficients(int sectionIndex, const std::array<double, 6>& coefficients, int rampLength);
+    bool isRamping() const noexcept { return rampSamplesRemaining > 0; }
+    
+    // Processes the block in place; it may have fewer channels than were prepared
+    void process(const juce::dsp::AudioBlock<SampleType>& block) noexcept;
+    
+    // The same, split up so that lane groups can be handed to different threads:
+    // processGroup() for every group (in any order, from any thread), then finishBlock()
+    int getNumGroups(const juce::dsp::AudioBlock<SampleType>& block) const noexcept;
+    void processGroup(const juce::dsp::AudioBlock<SampleType>& block, int group) noexcept;
+    void finishBlock(int numSamples) noexcept;
+    
+    bool isPassThrough() const noexcept { return numActiveSections == 0; }
+    
+    int getNumSections() const { return numSections; }
+    int getNumActiveSections() const { return numActiveSections; }
+    
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+    
+private:
+    struct SectionCoefficients
+    {
+        Vec b0, b1, b2, a1, a2;
+    };
+    
+    struct SectionState
+    {
+        Vec s1, s2;
+    };
+    
+    enum class SectionMode
+    {
+        bypassed,   // identity with clear state, skipped entirely
+        active,
+        draining    // identity, but still running until its state has decayed
+    };
+    
+    static SectionCoefficients normalise(const std::array<double, 6>& c) noexcept;
+    static bool isIdentity(const std::array<double, 6>& c) noexcept;
+    
+    template <bool withRamp>
+    void processLanes(SampleType* const* channels, int numChannelsInGroup, int startSample, int numSamples, int group) noexcept;
+    
+    void finishRamp() noexcept;
+    void updateSectionMode(int sectionIndex, bool targetIsIdentity) noexcept;
+    void retireDrainedSections() noexcept;
+    void updateActiveSections() noexcept;
+    bool hasDecayed(int sectionIndex) const noexcept;
+    
+    int numChannels = 0, numGroups = 0, numSections = 0;
+    
+    // While a ramp runs, coefficients holds where it started this block and targets where it ends;
+    // otherwise the two are the same
+    std::vector<SectionCoefficients> coefficients, targets, deltas;
+    std::vector<SectionCoefficients> rampedCoefficients; // numGroups * numSections, each group ramps its own copy
+    std::vector<char> targetIsIdentity;
+    int rampSamplesRemaining = 0;
+    
+    std::vector<SectionState> states; // numGroups * numSections, group-major
+    
+    std::vector<SectionMode> sectionModes;
+    std::vector<int> activeSections; // indices of the sections that run, in cascade order
+    int numActiveSections = 0;
+    bool anyDraining = false;
+};
@@ -0,0 +1,298 @@
+/*
+  ==============================================================================
+
+    Peak filter cascade built from topology-preserving-transform state-variable
+    filters, one channel per SIMD lane.
+
+  ==============================================================================
+*/
+
+#include "SVFCascade.h"
+
+namespace
+{
+    template <typename Vec>
+    Vec const zero = Vec::expand(0);
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::prepare(double sampleRate, const float* bandFreqs, const float* bandQualities, int newNumChannels, int newNumSections)
+{
+    jassert(sampleRate > 0.0);
+    
+    numChannels = newNumChannels;
+    numSections = newNumSections;
+    numGroups = (numChannels + lanesPerGroup - 1) / lanesPerGroup;
+    
+    warpedFreqs.resize((size_t) numSections);
+    inverseQualities.resize((size_t) numSections);
+    
+    for (int section = 0; section < numSections; ++section) {
+        // Bands above Nyquist (20k at 44.1k is fine, but not at 32k) are pinned just below it
+        auto const freq = juce::jmin((double) bandFreqs[section], 0.49 * sampleRate);
+        
+        warpedFreqs[(size_t) section] = std::tan(juce::MathConstants<double>::pi * freq / sampleRate);
+        inverseQualities[(size_t) section] = 1.0 / (double) bandQualities[section];
+    }
+    
+    // Sections start flat until a gain arrives
+    coefficients.assign((size_t) numSections, { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    targets.assign((size_t) numSections, { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    deltas.assign((size_t) numSections, { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> });
+    
+    for (int section = 0; section < numSections; ++section)
+        coefficients[(size_t) section] = targets[(size_t) section] = computeCoefficients(section, 0.0f);
+    
+    rampedCoefficients.resize((size_t) (numGroups * numSections));
+    targetIsFlat.assign((size_t) numSections, 1);
+    sectionIsActive.assign((size_t) numSections, 0);
+    states.resize((size_t) (numGroups * numSections));
+    activeSections.resize((size_t) numSections);
+    rampSamplesRemaining = 0;
+    
+    reset();
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::reset()
+{
+    for (auto& state : states)
+        state = { zero<Vec>, zero<Vec> };
+    
+    if (isRamping())
+        finishRamp();
+    
+    updateActiveSections();
+}
+
+template <typename SampleType>
+typename SVFCascade<SampleType>::SectionCoefficients SVFCascade<SampleType>::computeCoefficients(int sectionIndex, float gainInDecibels) const noexcept
+{
+    auto const A = std::pow(10.0, (double) gainInDecibels / 40.0);
+    auto const g = warpedFreqs[(size_t) sectionIndex];
+    auto const k = inverseQualities[(size_t) sectionIndex] / A;
+    
+    auto const a1 = 1.0 / (1.0 + g * (g + k));
+    auto const a2 = g * a1;
+    auto const a3 = g * a2;
+    
+    return { Vec::expand((SampleType) a1),
+             Vec::expand((SampleType) a2),
+             Vec::expand((SampleType) a3),
+             Vec::expand((SampleType) (k * (A * A - 1.0))) };
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::setGain(int sectionIndex, float gainInDecibels)
+{
+    jassert(juce::isPositiveAndBelow(sectionIndex, numSections));
+    
+    auto const index = (size_t) sectionIndex;
+    
+    coefficients[index] = targets[index] = computeCoefficients(sectionIndex, gainInDecibels);
+    deltas[index] = { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> };
+    targetIsFlat[index] = gainInDecibels == 0.0f;
+    
+    bool const shouldBeActive = ! targetIsFlat[index];
+    
+    if ((bool) sectionIsActive[index] == shouldBeActive)
+        return;
+    
+    // A section leaving clears its state now, so that it comes back from silence next time
+    if (! shouldBeActive)
+        for (int group = 0; group < numGroups; ++group)
+            states[(size_t) (group * numSections + sectionIndex)] = { zero<Vec>, zero<Vec> };
+    
+    sectionIsActive[index] = shouldBeActive;
+    updateActiveSections();
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::rampGain(int sectionIndex, float gainInDecibels, int rampLength)
+{
+    jassert(juce::isPositiveAndBelow(sectionIndex, numSections));
+    jassert(rampLength > 0);
+    
+    if (isRamping() && rampSamplesRemaining != rampLength)
+        finishRamp();
+    
+    auto const index = (size_t) sectionIndex;
+    auto const& from = coefficients[index];
+    auto const& to = targets[index] = computeCoefficients(sectionIndex, gainInDecibels);
+    auto const scale = (SampleType) 1 / (SampleType) rampLength;
+    
+    deltas[index] = { (to.a1 - from.a1) * scale,
+                      (to.a2 - from.a2) * scale,
+                      (to.a3 - from.a3) * scale,
+                      (to.m1 - from.m1) * scale };
+    
+    targetIsFlat[index] = gainInDecibels == 0.0f;
+    rampSamplesRemaining = rampLength;
+    
+    // Runs for the whole ramp, even one that ends flat; finishRamp() takes it out again
+    if (! sectionIsActive[index] && ! targetIsFlat[index]) {
+        sectionIsActive[index] = 1;
+        updateActiveSections();
+    }
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::finishRamp() noexcept
+{
+    rampSamplesRemaining = 0;
+    bool anyLeft = false;
+    
+    for (int section = 0; section < numSections; ++section) {
+        auto const index = (size_t) section;
+        
+        coefficients[index] = targets[index];
+        deltas[index] = { zero<Vec>, zero<Vec>, zero<Vec>, zero<Vec> };
+        
+        if (sectionIsActive[index] && targetIsFlat[index]) {
+            for (int group = 0; group < numGroups; ++group)
+                states[(size_t) (group * numSections + section)] = { zero<Vec>, zero<Vec> };
+            
+            sectionIsActive[index] = 0;
+            anyLeft = true;
+        }
+    }
+    
+    if (anyLeft)
+        updateActiveSections();
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block) noexcept
+{
+    if (! isPassThrough()) {
+        auto const groupsToProcess = getNumGroups(block);
+        
+        for (int group = 0; group < groupsToProcess; ++group)
+            processGroup(block, group);
+    }
+    
+    finishBlock((int) block.getNumSamples());
+}
+
+template <typename SampleType>
+int SVFCascade<SampleType>::getNumGroups(const juce::dsp::AudioBlock<SampleType>& block) const noexcept
+{
+    auto const channelsToProcess = juce::jmin((int) block.getNumChannels(), numChannels);
+    return (channelsToProcess + lanesPerGroup - 1) / lanesPerGroup;
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::processGroup(const juce::dsp::AudioBlock<SampleType>& block, int group) noexcept
+{
+    auto const channelsToProcess = juce::jmin((int) block.getNumChannels(), numChannels);
+    auto const firstChannel = group * lanesPerGroup;
+    auto const numChannelsInGroup = juce::jmin(lanesPerGroup, channelsToProcess - firstChannel);
+    
+    jassert(numChannelsInGroup > 0);
+    
+    SampleType* channels[lanesPerGroup];
+    
+    for (int lane = 0; lane < numChannelsInGroup; ++lane)
+        channels[lane] = block.getChannelPointer((size_t) (firstChannel + lane));
+    
+    auto const numSamples = (int) block.getNumSamples();
+    auto const rampSamples = juce::jmin(numSamples, rampSamplesRemaining);
+    
+    if (rampSamples > 0)
+        processLanes<true>(channels, numChannelsInGroup, 0, rampSamples, group);
+    
+    if (rampSamples < numSamples)
+        processLanes<false>(channels, numChannelsInGroup, rampSamples, numSamples - rampSamples, group);
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::finishBlock(int numSamples) noexcept
+{
+    if (! isRamping())
+        return;
+    
+    auto const advanced = juce::jmin(numSamples, rampSamplesRemaining);
+    rampSamplesRemaining -= advanced;
+    
+    if (rampSamplesRemaining == 0) {
+        finishRamp();
+        return;
+    }
+    
+    auto const steps = (SampleType) advanced;
+    
+    for (int section = 0; section < numSections; ++section) {
+        auto& c = coefficients[(size_t) section];
+        auto const& d = deltas[(size_t) section];
+        
+        c = { c.a1 + d.a1 * steps, c.a2 + d.a2 * steps, c.a3 + d.a3 * steps, c.m1 + d.m1 * steps };
+    }
+}
+
+template <typename SampleType>
+template <bool withRamp>
+void SVFCascade<SampleType>::processLanes(SampleType* const* channels, int numChannelsInGroup, int startSample, int numSamples, int group) noexcept
+{
+    alignas(Vec) SampleType frame[lanesPerGroup];
+    
+    auto* state = states.data() + group * numSections;
+    auto const* sectionsToRun = activeSections.data();
+    auto const numSectionsToRun = numActiveSections;
+    
+    auto* ramped = rampedCoefficients.data() + group * numSections;
+    auto const* sectionDeltas = deltas.data();
+    auto const* sectionCoefficients = withRamp ? ramped : targets.data();
+    
+    if (withRamp)
+        for (int k = 0; k < numSectionsToRun; ++k)
+            ramped[sectionsToRun[k]] = coefficients[(size_t) sectionsToRun[k]];
+    
+    for (int i = startSample; i < startSample + numSamples; ++i) {
+        for (int lane = 0; lane < lanesPerGroup; ++lane)
+            frame[lane] = lane < numChannelsInGroup ? channels[lane][i] : SampleType();
+        
+        auto x = Vec::fromRawArray(frame);
+        
+        for (int k = 0; k < numSectionsToRun; ++k) {
+            auto const section = sectionsToRun[k];
+            auto const& c = sectionCoefficients[section];
+            auto& s = state[section];
+            
+            auto const v3 = x - s.ic2;
+            auto const v1 = c.a1 * s.ic1 + c.a2 * v3;
+            auto const v2 = s.ic2 + c.a2 * s.ic1 + c.a3 * v3;
+            
+            s.ic1 = v1 + v1 - s.ic1;
+            s.ic2 = v2 + v2 - s.ic2;
+            x = x + c.m1 * v1;
+            
+            if (withRamp) {
+                auto& r = ramped[section];
+                auto const& d = sectionDeltas[section];
+                
+                r.a1 += d.a1;
+                r.a2 += d.a2;
+                r.a3 += d.a3;
+                r.m1 += d.m1;
+            }
+        }
+        
+        x.copyToRawArray(frame);
+        
+        for (int lane = 0; lane < numChannelsInGroup; ++lane)
+            channels[lane][i] = frame[lane];
+    }
+}
+
+template <typename SampleType>
+void SVFCascade<SampleType>::updateActiveSections() noexcept
+{
+    numActiveSections = 0;
+    
+    for (int section = 0; section < numSections; ++section)
+        if (sectionIsActive[(size_t) section])
+            activeSections[(size_t) numActiveSections++] = section;
+}
+
+template class SVFCascade<float>;
+template class SVFCascade<double>;
@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    Peak filter cascade built from topology-preserving-transform state-variable
+    filters, one channel per SIMD lane.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    The same 12 bell responses as the biquad engines (the TPT state-variable bell
+    with k = 1 / (Q A) is the bilinear transform of exactly the analog prototype
+    that makePeakFilter() uses), realised the way Zavalishin and Simper describe:
+    
+        v3 = x - ic2;  v1 = a1 ic1 + a2 v3;  v2 = ic2 + a2 ic1 + a3 v3
+        ic1 = 2 v1 - ic1;  ic2 = 2 v2 - ic2;  y = x + m1 v1
+    
+    The frequency warping g = tan(pi f / sr) is fixed per band and worked out once
+    in prepare(), in double. A gain change only has to recompute k and the four
+    scalars that depend on it, with no trig, which is what makes modulating the
+    gain cheap. The states hold integrator outputs rather than the tiny differences
+    a direct form carries, so the 20 Hz and 32 Hz bands stay accurate in float even
+    at 192 kHz and above. Templated on the sample type like the other engines.
+    
+    Gains can ramp linearly from one set of scalars to the next. With g fixed, a1,
+    a2 and a3 all move along one line, so the filter part of every point of the
+    ramp is an exact SVF for some k in between, and an SVF stays stable however
+    fast k moves. m1 ramps on its own, so in between the output is a stable SVF
+    whose mix lies between the two bells', not a bell itself.
+    
+    A bell at 0 dB has m1 = 0, so its output doesn't depend on its state: flat bands
+    are skipped, with their state cleared, until their gain moves again.
+*/
+template <typename SampleType>
+class SVFCascade
+{
+public:
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    
+    // Allocates the state and works out each band's warped frequency, call from prepareToPlay
+    void prepare(double sampleRate, const float* bandFreqs, const float* bandQualities, int numChannels, int numSections);
+    void reset();
+    
+    void setGain(int sectionIndex, float gainInDecibels);
+    
+    // Moves linearly to the new gain's coefficients over the next rampLength samples.
+    // Sections ramped at the same time share one countdown, so they must use the same length.
+    void rampGain(int sectionIndex, float gainInDecibels, int rampLength);
+    bool isRamping() const noexcept { return rampSamplesRemaining > 0; }
+    
+    void process(const juce::dsp::AudioBlock<SampleType>& block) noexcept;
+    
+    // Split up like SIMDCascade: processGroup() for every group, from any thread, then finishBlock()
+    int getNumGroups(const juce::dsp::AudioBlock<SampleType>& block) const noexcept;
+    void processGroup(const juce::dsp::AudioBlock<SampleType>& block, int group) noexcept;
+    void finishBlock(int numSamples) noexcept;
+    
+    bool isPassThrough() const noexcept { return numActiveSections == 0; }
+    
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+
+private:
+    struct SectionCoefficients
+    {
+        Vec a1, a2, a3, m1;
+    };
+    
+    struct SectionState
+    {
+        Vec ic1, ic2;
+    };
+    
+    SectionCoefficients computeCoefficients(int sectionIndex, float gainInDecibels) const noexcept;
+    
+    template <bool withRamp>
+    void processLanes(SampleType* const* channels, int numChannelsInGroup, int startSample, int numSamples, int group) noexcept;
+    
+    void finishRamp() noexcept;
+    void updateActiveSections() noexcept;
+    
+    int numChannels = 0, numGroups = 0, numSections = 0;
+    
+    // Per band: g = tan(pi f / sr) and 1 / Q, the parts of the design that never change
+    std::vector<double> warpedFreqs, inverseQualities;
+    
+    // Same arrangement as SIMDCascade: coefficients is where a ramp stands at the start of the block
+    std::vector<SectionCoefficients> coefficients, targets, deltas;
+    std::vector<SectionCoefficients> rampedCoefficients; // numGroups * numSections
+    std::vector<char> targetIsFlat, sectionIsActive;
+    int rampSamplesRemaining = 0;
+    
+    std::vector<SectionState> states; // numGroups * numSections, group-major
+    
+    std::vector<int> activeSections;
+    int numActiveSections = 0;
+};
@@ -0,0 +1,200 @@
+/*
+  ==============================================================================
+
+    Pre- and post-EQ spectra for the editor, analysed on a background thread
+    from what the processor's AnalyserTap collects.
+
+  ==============================================================================
+*/
+
+#include "SpectrumAnalyser.h"
+#include "ResponseCurve.h"
+
+namespace
+{
+    // Per analysed frame, i.e. per display frame while audio is coming in
+    constexpr float releaseAmount = 0.2f;
+}
+
+SpectrumAnalyser::SpectrumAnalyser(AnalyserTap& tapToRead)
+    : juce::Thread("Spectrum analyser"), tap(tapToRead)
+{
+    for (auto& analysis : analyses) {
+        analysis.history.assign((size_t) fftSize, 0.0f);
+        analysis.fftData.assign((size_t) (2 * fftSize), 0.0f);
+        analysis.levels.fill(floorDecibels);
+    }
+    
+    readBuffer.resize((size_t) fftSize);
+    
+    tap.setActive(true);
+    startThread();
+}
+
+SpectrumAnalyser::~SpectrumAnalyser()
+{
+    tap.setActive(false);
+    stopThread(1000);
+}
+
+double SpectrumAnalyser::getColumnFrequency(int column)
+{
+    return ResponseCurve::getFrequencyAt(((double) column + 0.5) / numColumns);
+}
+
+void SpectrumAnalyser::update(double newSampleRate, juce::Rectangle<float> area)
+{
+    {
+        const juce::SpinLock::ScopedLockType sl(requestLock);
+        requestedSampleRate = newSampleRate;
+        requestedArea = area;
+    }
+    
+    notify();
+}
+
+void SpectrumAnalyser::run()
+{
+    juce::Rectangle<float> builtArea;
+    
+    while (! threadShouldExit()) {
+        wait(-1);
+        
+        double newSampleRate;
+        juce::Rectangle<float> area;
+        
+        {
+            const juce::SpinLock::ScopedLockType sl(requestLock);
+            newSampleRate = requestedSampleRate;
+            area = requestedArea;
+        }
+        
+        if (newSampleRate <= 0.0 || area.isEmpty())
+            continue;
+        
+        if (newSampleRate != sampleRate)
+            prepare(newSampleRate);
+        
+        bool changed = area != builtArea;
+        
+        for (int point = 0; point < AnalyserTap::numPoints; ++point) {
+            if (readNewSamples((AnalyserTap::Point) point)) {
+                analyse(analyses[(size_t) point]);
+                changed = true;
+            }
+        }
+        
+        // With the transport stopped nothing arrives, and the last spectra stay up
+        if (changed) {
+            buildPaths(area);
+            builtArea = area;
+        }
+    }
+}
+
+void SpectrumAnalyser::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    
+    auto const binsPerHertz = fftSize / sampleRate;
+    auto const nyquistBin = (float) (fftSize / 2);
+    
+    for (int column = 0; column < numColumns; ++column) {
+        auto const low = ResponseCurve::getFrequencyAt((double) column / numColumns) * binsPerHertz;
+        auto const high = ResponseCurve::getFrequencyAt((double) (column + 1) / numColumns) * binsPerHertz;
+        
+        columns[(size_t) column] = { juce::jlimit(0.0f, nyquistBin, (float) low), juce::jlimit(0.0f, nyquistBin, (float) high) };
+    }
+}
+
+bool SpectrumAnalyser::readNewSamples(AnalyserTap::Point point)
+{
+    auto& history = analyses[(size_t) point].history;
+    bool anyRead = false;
+    
+    // Only the latest fftSize samples matter, anything older is shifted out
+    while (auto const numRead = tap.read(point, readBuffer.data(), fftSize)) {
+        std::move(history.begin() + numRead, history.end(), history.begin());
+        std::copy_n(readBuffer.begin(), numRead, history.end() - numRead);
+        anyRead = true;
+    }
+    
+    return anyRead;
+}
+
+void SpectrumAnalyser::analyse(Analysis& analysis)
+{
+    auto* data = analysis.fftData.data();
+    
+    std::copy(analysis.history.begin(), analysis.history.end(), data);
+    window.multiplyWithWindowingTable(data, (size_t) fftSize);
+    fft.performFrequencyOnlyForwardTransform(data);
+    
+    // A full scale sine peaks at fftSize / 4 through a Hann window
+    auto const scale = 4.0f / fftSize;
+    
+    for (int column = 0; column < numColumns; ++column) {
+        auto const decibels = juce::Decibels::gainToDecibels(getColumnLevel(data, columns[(size_t) column]) * scale, floorDecibels);
+        auto& level = analysis.levels[(size_t) column];
+        
+        level = decibels >= level ? decibels : level + (decibels - level) * releaseAmount;
+    }
+}
+
+float SpectrumAnalyser::getColumnLevel(const float* magnitudes, const Column& column) const
+{
+    auto const lastBin = fftSize / 2;
+    
+    // Low columns are narrower than a bin, so they read the spectrum in between bins instead
+    if (column.highBin - column.lowBin < 1.0f) {
+        auto const centre = 0.5f * (column.lowBin + column.highBin);
+        auto const bin = juce::jmin((int) centre, lastBin - 1);
+        auto const fraction = centre - (float) bin;
+        
+        return magnitudes[bin] + fraction * (magnitudes[bin + 1] - magnitudes[bin]);
+    }
+    
+    auto const firstBin = juce::jmin((int) std::ceil(column.lowBin), lastBin);
+    auto const endBin = juce::jlimit(firstBin + 1, lastBin + 1, (int) std::floor(column.highBin) + 1);
+    
+    return *std::max_element(magnitudes + firstBin, magnitudes + endBin);
+}
+
+void SpectrumAnalyser::buildPaths(juce::Rectangle<float> area)
+{
+    auto getX = [&](int column) { return area.getX() + area.getWidth() * ((float) column + 0.5f) / numColumns; };
+    auto getY = [&](float decibels)
+    {
+        return juce::jmap(juce::jlimit(floorDecibels, ceilingDecibels, decibels), floorDecibels, ceilingDecibels, area.getBottom(), area.getY());
+    };
+    
+    auto const& pre = analyses[AnalyserTap::preEQ].levels;
+    auto const& post = analyses[AnalyserTap::postEQ].levels;
+    
+    spectra.publish([&](Spectra& published)
+    {
+        published.preEQLevels = pre;
+        
+        auto& filled = published.preEQ;
+        filled.clear();
+        filled.startNewSubPath(area.getX(), area.getBottom());
+        
+        for (int column = 0; column < numColumns; ++column)
+            filled.lineTo(getX(column), getY(pre[(size_t) column]));
+        
+        filled.lineTo(area.getRight(), area.getBottom());
+        filled.closeSubPath();
+        
+        line.clear();
+        
+        for (int column = 0; column < numColumns; ++column) {
+            if (column == 0)
+                line.startNewSubPath(getX(column), getY(post[(size_t) column]));
+            else
+                line.lineTo(getX(column), getY(post[(size_t) column]));
+        }
+        
+        published.postEQ.clear();
+        juce::PathStrokeType(1.5f, juce::PathStrokeType::curved, juce::PathStrokeType::rounded).createStrokedPath(published.postEQ, line);
+    });
+}
@@ -0,0 +1,101 @@
+/*
+  ==============================================================================
+
+    Pre- and post-EQ spectra for the editor, analysed on a background thread
+    from what the processor's AnalyserTap collects.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandLayout.h"
+#include "AnalyserTap.h"
+#include "CoefficientExchange.h"
+
+/**
+    Exists only while an editor does, and keeps the tap active for that long.
+    
+    The editor calls update() once per display frame. That wakes the thread, which
+    drains both FIFOs into a history of the latest fftSize samples, windows it,
+    runs the FFT and reduces the bins to columns. The columns split each band's
+    slider into equal parts, on the same axis as the response curve, so every
+    band region gets the same number of columns however narrow it is in Hz.
+    A column takes the loudest bin it covers, or interpolates between the two
+    nearest bins where it's narrower than one. Levels rise straight away and
+    fall back smoothly. The finished paths go to the editor through a
+    CoefficientExchange, so neither thread ever waits for the other.
+*/
+class SpectrumAnalyser : private juce::Thread
+{
+public:
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int columnsPerBand = 24;
+    static constexpr int numColumns = Bands::numBands * columnsPerBand;
+    
+    // What the display spans, in dBFS; a full scale sine reads 0
+    static constexpr float floorDecibels = -90.0f, ceilingDecibels = 0.0f;
+    
+    // The input as a filled area and the output as the outline of a line, both in the editor's coordinates,
+    // and the input's level per column in dBFS, for matching it
+    struct Spectra
+    {
+        juce::Path preEQ, postEQ;
+        std::array<float, numColumns> preEQLevels {};
+    };
+    
+    explicit SpectrumAnalyser(AnalyserTap& tapToRead);
+    ~SpectrumAnalyser() override;
+    
+    // Message thread, once per frame
+    void update(double sampleRate, juce::Rectangle<float> area);
+    
+    // Message thread. The newest spectra if they changed since the last call, otherwise nullptr;
+    // they stay valid until the next call.
+    const Spectra* pickUpLatest() noexcept { return spectra.pickUpLatest(); }
+    
+    // The centre of a column, in Hz
+    static double getColumnFrequency(int column);
+
+private:
+    struct Analysis
+    {
+        std::vector<float> history, fftData;
+        std::array<float, numColumns> levels;
+    };
+    
+    struct Column
+    {
+        float lowBin, highBin;
+    };
+    
+    void run() override;
+    
+    void prepare(double sampleRate);
+    bool readNewSamples(AnalyserTap::Point point);
+    void analyse(Analysis& analysis);
+    float getColumnLevel(const float* magnitudes, const Column& column) const;
+    void buildPaths(juce::Rectangle<float> area);
+    
+    AnalyserTap& tap;
+    
+    // Written by update(), copied out by the thread
+    juce::SpinLock requestLock;
+    double requestedSampleRate = 0.0;
+    juce::Rectangle<float> requestedArea;
+    
+    // Analysis thread only
+    double sampleRate = 0.0;
+    juce::dsp::FFT fft {fftOrder};
+    juce::dsp::WindowingFunction<float> window {(size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false};
+    std::array<Analysis, AnalyserTap::numPoints> analyses;
+    std::array<Column, numColumns> columns;
+    std::vector<float> readBuffer;
+    juce::Path line;
+    
+    CoefficientExchange<Spectra> spectra;
+    
+    JUCE_DECLARE_NON_COPYABLE (SpectrumAnalyser)
+};
@@ -0,0 +1,355 @@
+/*
+  ==============================================================================
+
+    Auto-EQ: solves for the band gains whose combined response best fits a
+    target magnitude curve, on a background thread.
+
+  ==============================================================================
+*/
+
+#include "TargetMatcher.h"
+#include "ResponseCurve.h"
+
+namespace
+{
+    // Only a safety net, a fit settles in a handful of passes
+    constexpr int maxPasses = 64;
+    
+    bool isNumber(const juce::String& token)
+    {
+        return token.isNotEmpty() && token.containsOnly("0123456789.-+eE");
+    }
+}
+
+TargetMatcher::TargetMatcher(const juce::NormalisableRange<float>& range)
+    : juce::Thread("Target matcher"),
+      gainRange(range),
+      stepSize(range.interval > 0.0f ? range.interval : 0.5f),
+      numSteps(juce::roundToInt((range.end - range.start) / stepSize) + 1)
+{
+    startThread();
+}
+
+TargetMatcher::~TargetMatcher()
+{
+    cancel();
+    stopThread(1000);
+}
+
+double TargetMatcher::getPointFrequency(int point)
+{
+    return ResponseCurve::getFrequencyAt((double) point / (numPoints - 1));
+}
+
+bool TargetMatcher::makeTarget(std::vector<juce::Point<double>> curve, Target& target)
+{
+    curve.erase(std::remove_if(curve.begin(), curve.end(), [](const juce::Point<double>& p)
+    {
+        return ! (p.x > 0.0 && std::isfinite(p.x) && std::isfinite(p.y));
+    }), curve.end());
+    
+    if (curve.empty())
+        return false;
+    
+    std::sort(curve.begin(), curve.end(), [](const juce::Point<double>& a, const juce::Point<double>& b) { return a.x < b.x; });
+    
+    for (int point = 0; point < numPoints; ++point) {
+        auto const frequency = getPointFrequency(point);
+        auto const above = std::upper_bound(curve.begin(), curve.end(), frequency, [](double f, const juce::Point<double>& p) { return f < p.x; });
+        
+        if (above == curve.begin()) {
+            target[(size_t) point] = (float) curve.front().y;
+        }
+        else if (above == curve.end()) {
+            target[(size_t) point] = (float) curve.back().y;
+        }
+        else {
+            auto const below = std::prev(above);
+            auto const position = std::log(frequency / below->x) / std::log(above->x / below->x);
+            target[(size_t) point] = (float) (below->y + position * (above->y - below->y));
+        }
+    }
+    
+    return true;
+}
+
+bool TargetMatcher::parseCSV(const juce::String& text, Target& target)
+{
+    std::vector<juce::Point<double>> curve;
+    
+    for (auto const& line : juce::StringArray::fromLines(text)) {
+        auto tokens = juce::StringArray::fromTokens(line, ",; \t", "\"");
+        tokens.removeEmptyStrings();
+        
+        if (tokens.size() < 2)
+            continue;
+        
+        auto const frequency = tokens[0].unquoted().trim(), decibels = tokens[1].unquoted().trim();
+        
+        if (isNumber(frequency) && isNumber(decibels))
+            curve.push_back({ frequency.getDoubleValue(), decibels.getDoubleValue() });
+    }
+    
+    return makeTarget(std::move(curve), target);
+}
+
+int TargetMatcher::match(double sampleRate, const Target& target)
+{
+    auto const number = ++latestRequest;
+    
+    {
+        const juce::SpinLock::ScopedLockType sl(requestLock);
+        request.number = number;
+        request.sampleRate = sampleRate;
+        request.target = target;
+    }
+    
+    notify();
+    return number;
+}
+
+const TargetMatcher::Result* TargetMatcher::pickUpLatest() noexcept
+{
+    // A result that was cancelled or superseded after it was published is dropped here
+    auto const* result = results.pickUpLatest();
+    return result != nullptr && result->request == latestRequest.load() ? result : nullptr;
+}
+
+void TargetMatcher::run()
+{
+    int solved = 0;
+    
+    while (! threadShouldExit()) {
+        Request latest;
+        
+        {
+            const juce::SpinLock::ScopedLockType sl(requestLock);
+            latest = request;
+        }
+        
+        if (latest.number != solved && ! isCancelled(latest.number) && latest.sampleRate > 0.0) {
+            Result result;
+            
+            if (solve(latest, result))
+                results.publish([&result](Result& published) { published = result; });
+            
+            solved = latest.number;
+        }
+        
+        // Whatever match() posted while this pass ran has already notified, so this returns straight away
+        wait(-1);
+    }
+}
+
+int TargetMatcher::getNearestStep(float gainInDecibels) const noexcept
+{
+    return juce::jlimit(0, numSteps - 1, juce::roundToInt((gainInDecibels - gainRange.start) / stepSize));
+}
+
+bool TargetMatcher::prepare(double sampleRate, int requestNumber)
+{
+    using Wide = juce::dsp::SIMDRegister<double>;
+    constexpr int wideLanes = (int) Wide::SIMDNumElements;
+    constexpr int numWideGroups = numPoints / wideLanes;
+    
+    auto const table = PeakCoefficientTable::getShared(sampleRate, Bands::freqs.data(), Bands::qualities.data(), numBands, gainRange);
+    
+    preparedSampleRate = 0.0;
+    responses.resize((size_t) (numBands * numSteps * numGroups));
+    
+    std::array<Wide, numWideGroups> phis;
+    alignas(Wide) double lanes[wideLanes];
+    
+    for (int group = 0; group < numWideGroups; ++group) {
+        for (int lane = 0; lane < wideLanes; ++lane) {
+            auto const frequency = juce::jlimit(1.0, 0.49 * sampleRate, getPointFrequency(group * wideLanes + lane));
+            auto const halfOmega = juce::MathConstants<double>::pi * frequency / sampleRate;
+            
+            lanes[lane] = std::sin(halfOmega) * std::sin(halfOmega);
+        }
+        
+        phis[(size_t) group] = Wide::fromRawArray(lanes);
+    }
+    
+    alignas(Wide) double numerator[wideLanes], denominator[wideLanes];
+    alignas(Vec) float decibels[numPoints];
+    
+    for (int band = 0; band < numBands; ++band) {
+        if (isCancelled(requestNumber))
+            return false;
+        
+        for (int step = 0; step < numSteps; ++step) {
+            // Normalised, so a0 is 1
+            auto const c = table->getCoefficients(band, getStepGain(step));
+            auto const numeratorTerms = PeakCoefficientTable::getSquaredMagnitudeTerms(c[0], c[1], c[2]);
+            auto const denominatorTerms = PeakCoefficientTable::getSquaredMagnitudeTerms(c[3], c[4], c[5]);
+            
+            auto const n0 = Wide::expand(numeratorTerms[0]), n1 = Wide::expand(numeratorTerms[1]), n2 = Wide::expand(numeratorTerms[2]);
+            auto const d0 = Wide::expand(denominatorTerms[0]), d1 = Wide::expand(denominatorTerms[1]), d2 = Wide::expand(denominatorTerms[2]);
+            
+            for (int group = 0; group < numWideGroups; ++group) {
+                auto const phi = phis[(size_t) group];
+                
+                (n0 + phi * (n1 + phi * n2)).copyToRawArray(numerator);
+                (d0 + phi * (d1 + phi * d2)).copyToRawArray(denominator);
+                
+                for (int lane = 0; lane < wideLanes; ++lane)
+                    decibels[group * wideLanes + lane] = (float) (10.0 * std::log10(juce::jmax(1.0e-12, numerator[lane] / denominator[lane])));
+            }
+            
+            auto* response = responses.data() + (size_t) ((band * numSteps + step) * numGroups);
+            
+            for (int group = 0; group < numGroups; ++group)
+                response[group] = Vec::fromRawArray(decibels + group * lanesPerGroup);
+        }
+    }
+    
+    preparedSampleRate = sampleRate;
+    return true;
+}
+
+bool TargetMatcher::solve(const Request& latest, Result& result)
+{
+    if (latest.sampleRate != preparedSampleRate && ! prepare(latest.sampleRate, latest.number))
+        return false;
+    
+    std::array<Vec, numGroups> target, total, wanted;
+    alignas(Vec) float lanes[lanesPerGroup];
+    
+    for (int group = 0; group < numGroups; ++group) {
+        std::copy_n(latest.target.data() + group * lanesPerGroup, lanesPerGroup, lanes);
+        target[(size_t) group] = Vec::fromRawArray(lanes);
+    }
+    
+    // Starting point: each band's response at its largest step, as a shape that scales with the gain
+    auto const basisStep = std::abs(gainRange.end) >= std::abs(gainRange.start) ? numSteps - 1 : 0;
+    auto const basisGain = (double) getStepGain(basisStep);
+    
+    std::array<std::array<double, numBands>, numBands> normal {};
+    std::array<double, numBands> solution {};
+    
+    for (int a = 0; a < numBands; ++a) {
+        auto const* shapeA = getResponse(a, basisStep);
+        auto projection = Vec::expand(0.0f);
+        
+        for (int group = 0; group < numGroups; ++group)
+            projection += shapeA[group] * target[(size_t) group];
+        
+        solution[(size_t) a] = (double) projection.sum() / basisGain;
+        
+        for (int b = a; b < numBands; ++b) {
+            auto const* shapeB = getResponse(b, basisStep);
+            auto product = Vec::expand(0.0f);
+            
+            for (int group = 0; group < numGroups; ++group)
+                product += shapeA[group] * shapeB[group];
+            
+            normal[(size_t) a][(size_t) b] = normal[(size_t) b][(size_t) a] = (double) product.sum() / (basisGain * basisGain);
+        }
+    }
+    
+    // Neighbouring bands overlap a lot (16k and 20k hardly differ), a little damping keeps their split sane
+    double trace = 0.0;
+    
+    for (int i = 0; i < numBands; ++i)
+        trace += normal[(size_t) i][(size_t) i];
+    
+    for (int i = 0; i < numBands; ++i)
+        normal[(size_t) i][(size_t) i] += 1.0e-3 * trace / numBands;
+    
+    // Symmetric positive definite, so elimination without pivoting is fine
+    for (int i = 0; i < numBands; ++i) {
+        for (int j = i + 1; j < numBands; ++j) {
+            auto const factor = normal[(size_t) j][(size_t) i] / normal[(size_t) i][(size_t) i];
+            
+            for (int k = i; k < numBands; ++k)
+                normal[(size_t) j][(size_t) k] -= factor * normal[(size_t) i][(size_t) k];
+            
+            solution[(size_t) j] -= factor * solution[(size_t) i];
+        }
+    }
+    
+    for (int i = numBands - 1; i >= 0; --i) {
+        for (int k = i + 1; k < numBands; ++k)
+            solution[(size_t) i] -= normal[(size_t) i][(size_t) k] * solution[(size_t) k];
+        
+        solution[(size_t) i] /= normal[(size_t) i][(size_t) i];
+    }
+    
+    std::array<int, numBands> steps;
+    total.fill(Vec::expand(0.0f));
+    
+    for (int band = 0; band < numBands; ++band) {
+        steps[(size_t) band] = getNearestStep(std::isfinite(solution[(size_t) band]) ? (float) solution[(size_t) band] : 0.0f);
+        
+        auto const* response = getResponse(band, steps[(size_t) band]);
+        
+        for (int group = 0; group < numGroups; ++group)
+            total[(size_t) group] += response[group];
+    }
+    
+    // Then one band at a time to its best step against all the others, until nothing moves
+    for (int pass = 0; pass < maxPasses; ++pass) {
+        bool changed = false;
+        
+        for (int band = 0; band < numBands; ++band) {
+            if (isCancelled(latest.number))
+                return false;
+            
+            auto const* current = getResponse(band, steps[(size_t) band]);
+            
+            // What this band would have to add on top of the others
+            for (int group = 0; group < numGroups; ++group)
+                wanted[(size_t) group] = target[(size_t) group] - total[(size_t) group] + current[group];
+            
+            auto bestStep = steps[(size_t) band];
+            auto bestError = std::numeric_limits<float>::max();
+            
+            for (int step = 0; step < numSteps; ++step) {
+                auto const* response = getResponse(band, step);
+                auto error = Vec::expand(0.0f);
+                
+                for (int group = 0; group < numGroups; ++group) {
+                    auto const difference = wanted[(size_t) group] - response[group];
+                    error += difference * difference;
+                }
+                
+                // Ties keep the current step, so a pass that finds nothing better ends the fit
+                auto const sum = error.sum();
+                
+                if (sum < bestError || (sum == bestError && step == steps[(size_t) band])) {
+                    bestError = sum;
+                    bestStep = step;
+                }
+            }
+            
+            if (bestStep != steps[(size_t) band]) {
+                auto const* best = getResponse(band, bestStep);
+                
+                for (int group = 0; group < numGroups; ++group)
+                    total[(size_t) group] += best[group] - current[group];
+                
+                steps[(size_t) band] = bestStep;
+                changed = true;
+            }
+        }
+        
+        if (! changed)
+            break;
+    }
+    
+    auto error = Vec::expand(0.0f);
+    
+    for (int group = 0; group < numGroups; ++group) {
+        auto const difference = target[(size_t) group] - total[(size_t) group];
+        error += difference * difference;
+    }
+    
+    result.request = latest.number;
+    result.rmsErrorDecibels = std::sqrt(error.sum() / numPoints);
+    
+    for (int band = 0; band < numBands; ++band)
+        result.bandGains[(size_t) band] = getStepGain(steps[(size_t) band]);
+    
+    return true;
+}
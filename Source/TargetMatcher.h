@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    Auto-EQ: solves for the band gains whose combined response best fits a
+    target magnitude curve, on a background thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandLayout.h"
+#include "PeakCoefficientTable.h"
+#include "CoefficientExchange.h"
+
+/**
+    A target is a curve in dB relative to flat, sampled at numPoints frequencies
+    that follow the editor's axis (ResponseCurve::getFrequencyAt), so every band
+    region weighs the same in the fit however narrow it is in Hz. makeTarget()
+    resamples any (frequency, dB) curve onto those points, e.g. a CSV file
+    through parseCSV(), or the analyser's spectrum.
+    
+    Per sample rate, the worker evaluates every gain step of every band from the
+    shared PeakCoefficientTable, i.e. exactly the coefficients the processor
+    runs, in the same sin^2(w/2) form as ResponseCurve and a SIMD register of
+    points at a time. In dB the bands simply add up, so the fit never evaluates
+    a filter again after that:
+    
+    - a least squares fit of each band's response shape, scaled linearly with
+      its gain, gives a continuous starting point,
+    - which is clamped and snapped to the parameters' steps,
+    - then each band in turn moves to whichever of its steps leaves the least
+      squared error against the rest, until a whole pass changes nothing.
+    
+    Every step of that is exact against the table, so the result is never worse
+    than the snapped starting point. A solve takes a few milliseconds once the
+    responses are evaluated.
+    
+    match() supersedes any solve still running and cancel() drops it, both
+    without waiting: the worker checks between bands and gives up, and only
+    results of the latest request are ever handed out.
+*/
+class TargetMatcher : private juce::Thread
+{
+public:
+    static constexpr int numBands = Bands::numBands;
+    static constexpr int numPoints = 256;
+    
+    using Target = std::array<float, numPoints>;
+    using Gains = std::array<float, numBands>;
+    
+    struct Result
+    {
+        int request = 0;
+        Gains bandGains {};
+        float rmsErrorDecibels = 0.0f;
+    };
+    
+    explicit TargetMatcher(const juce::NormalisableRange<float>& gainRange);
+    ~TargetMatcher() override;
+    
+    // Message thread. Starts fitting the target, and returns the number its result will carry.
+    int match(double sampleRate, const Target& target);
+    
+    // Any thread. Whatever is being solved is dropped, and no result is handed out for it.
+    void cancel() noexcept { ++latestRequest; }
+    
+    // Message thread. The result of the latest request once it's done, otherwise nullptr;
+    // it stays valid until the next call.
+    const Result* pickUpLatest() noexcept;
+    
+    // Where the target's points are, in Hz
+    static double getPointFrequency(int point);
+    
+    // Linear on a log frequency axis in between the curve's points, and held flat past its ends.
+    // The curve is (Hz, dB) pairs in any order; false if it has none above 0 Hz.
+    static bool makeTarget(std::vector<juce::Point<double>> curve, Target& target);
+    
+    // A frequency and a level in dB per line, separated by commas, semicolons or white space.
+    // Headers, comments and other lines that don't start with two numbers are skipped.
+    static bool parseCSV(const juce::String& text, Target& target);
+
+private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int lanesPerGroup = (int) Vec::SIMDNumElements;
+    static constexpr int numGroups = numPoints / lanesPerGroup;
+    
+    struct Request
+    {
+        int number = 0;
+        double sampleRate = 0.0;
+        Target target {};
+    };
+    
+    void run() override;
+    
+    bool prepare(double sampleRate, int requestNumber);
+    bool solve(const Request& latest, Result& result);
+    bool isCancelled(int requestNumber) const noexcept { return threadShouldExit() || latestRequest.load() != requestNumber; }
+    
+    float getStepGain(int step) const noexcept { return gainRange.start + (float) step * stepSize; }
+    int getNearestStep(float gainInDecibels) const noexcept;
+    
+    // The band's response at the step, in dB, numGroups registers of points
+    const Vec* getResponse(int bandIndex, int step) const noexcept
+    {
+        return responses.data() + (size_t) ((bandIndex * numSteps + step) * numGroups);
+    }
+    
+    juce::NormalisableRange<float> const gainRange;
+    float const stepSize;
+    int const numSteps;
+    
+    std::atomic<int> latestRequest {0};
+    
+    // Written by match(), copied out by the worker
+    juce::SpinLock requestLock;
+    Request request;
+    
+    // Worker only
+    double preparedSampleRate = 0.0;
+    std::vector<Vec> responses; // numBands * numSteps * numGroups, band-major
+    
+    CoefficientExchange<Result> results;
+    
+    JUCE_DECLARE_NON_COPYABLE (TargetMatcher)
+};